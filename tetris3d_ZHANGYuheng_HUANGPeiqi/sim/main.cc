@@ -0,0 +1,460 @@
+// tetris3d_sim: plays games headless at full CPU speed.
+//
+// Only links the GL free tetris3d_core library, build it with:
+//   cmake -S . -B build && cmake --build build --target tetris3d_sim
+//
+// Usage:
+//   tetris3d_sim [--games N] [--seed S] [--max-ticks T] [--script FILE]
+//                [--bot] [--rollout] [--beam] [--bag] [--threads T]
+//                [--scaling]
+//   tetris3d_sim --replay FILE [--seek TICK]
+//
+// Game i is played with the seed S + i, --bag deals the blocks from
+// shuffled bags instead of drawing them uniformly. The games run on a pool
+// of T threads, all the cores by default. The results only depend on the
+// seeds, not on the thread count. --scaling plays the batch with 1, 2, 4..
+// threads up to T and reports the speedup of each run.
+//
+// --replay fast-forwards a recorded game to its end, or to the given tick,
+// and prints the state of the game there.
+//
+// --bot plays every block with the heuristic bot, which lands it on the
+// tick it appears.
+//
+// --rollout plays every block with the Monte Carlo rollout bot instead. The
+// games are played one after the other and the T threads run the rollouts
+// of each block, the report adds the rollouts/sec.
+//
+// --beam plays every block with the beam search bot, which also knows the
+// next blocks. The games are played one after the other and the T threads
+// expand the boards of each block, the report adds the placements scored
+// per second.
+//
+// Without a script or the bot every tick gets random actions. A script has
+// one line per tick, each character applies an action on that tick:
+//   x/X move along +x/-x, z/Z move along +z/-z,
+//   1/2, 3/4, 5/6 rotate clockwise/counterclockwise about x, y, z,
+//   v soft drop, V hard drop, _ accelerate
+// and the script is replayed from the start when it runs out.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "beam_search.h"
+#include "bot.h"
+#include "logic.h"
+#include "replay.h"
+#include "rollout.h"
+#include "thread_pool.h"
+
+namespace {
+
+// games played by one task of the thread pool
+const u32 games_per_task = 16;
+
+struct Options {
+    u32 games = 1000;
+    u32 seed = 1;
+    u32 max_ticks = 1000000;
+    std::string script_path;
+    bool bot = false;
+    bool rollout = false;
+    bool beam = false;
+    Settings::BlockGenerator block_generator = Settings::block_generator;
+    u32 threads = ThreadPool::DefaultThreadCount();
+    bool scaling = false;
+    std::string replay_path;
+    u64 seek_tick = ~u64(0);
+};
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        auto has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--games") && has_value) {
+            options.games = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && has_value) {
+            options.seed = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-ticks") && has_value) {
+            options.max_ticks = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--script") && has_value) {
+            options.script_path = argv[++i];
+        } else if (!strcmp(argv[i], "--bot")) {
+            options.bot = true;
+        } else if (!strcmp(argv[i], "--rollout")) {
+            options.rollout = true;
+        } else if (!strcmp(argv[i], "--beam")) {
+            options.beam = true;
+        } else if (!strcmp(argv[i], "--bag")) {
+            options.block_generator = Settings::BlockGenerator::Bag;
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            options.threads = std::max(atoi(argv[++i]), 1);
+        } else if (!strcmp(argv[i], "--scaling")) {
+            options.scaling = true;
+        } else if (!strcmp(argv[i], "--replay") && has_value) {
+            options.replay_path = argv[++i];
+        } else if (!strcmp(argv[i], "--seek") && has_value) {
+            options.seek_tick = strtoull(argv[++i], nullptr, 10);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Actions and acceleration of one tick
+struct TickInput {
+    std::vector<GameLogic::Action> actions;
+    bool accelerate = false;
+};
+
+TickInput DecodeScriptLine(const std::string& line) {
+    using GameLogic::Action;
+    TickInput input;
+    for (auto c : line) {
+        switch (c) {
+        case 'x':
+            input.actions.push_back(Action::MoveXPositive);
+            break;
+        case 'X':
+            input.actions.push_back(Action::MoveXNegative);
+            break;
+        case 'z':
+            input.actions.push_back(Action::MoveZPositive);
+            break;
+        case 'Z':
+            input.actions.push_back(Action::MoveZNegative);
+            break;
+        case '1':
+            input.actions.push_back(Action::RotateXClockwise);
+            break;
+        case '2':
+            input.actions.push_back(Action::RotateXCounterClockwise);
+            break;
+        case '3':
+            input.actions.push_back(Action::RotateYClockwise);
+            break;
+        case '4':
+            input.actions.push_back(Action::RotateYCounterClockwise);
+            break;
+        case '5':
+            input.actions.push_back(Action::RotateZClockwise);
+            break;
+        case '6':
+            input.actions.push_back(Action::RotateZCounterClockwise);
+            break;
+        case 'v':
+            input.actions.push_back(Action::SoftDrop);
+            break;
+        case 'V':
+            input.actions.push_back(Action::HardDrop);
+            break;
+        case '_':
+            input.accelerate = true;
+            break;
+        default:
+            break;
+        }
+    }
+    return input;
+}
+
+// Policy playing the rollout bot, the beam search bot, the heuristic bot,
+// the script, or random moves and rotations with the drops left to the
+// gravity. Every worker has its own player.
+class Player {
+  public:
+    Player(const std::vector<TickInput>& script, bool use_bot,
+           GameLogic::RolloutBot* rollout_bot = nullptr,
+           GameLogic::BeamSearchBot* beam_bot = nullptr)
+        : script(script), use_bot(use_bot), rollout_bot(rollout_bot),
+          beam_bot(beam_bot) {}
+
+    // Start a new game. The player gets its own stream derived from the
+    // seed, so the blocks only depend on the seed of the game.
+    void Reset(u64 seed) { rng.Seed(~seed); }
+
+    const TickInput& Decide(u32 tick, const GameLogic::GameState& state) {
+        if (use_bot || rollout_bot || beam_bot) {
+            bot_input.actions.clear();
+            if (state.phase == GameLogic::GamePhase::NewBlockCreation) {
+                if (rollout_bot) {
+                    rollout_bot->Think(state, bot_input.actions);
+                } else if (beam_bot) {
+                    beam_bot->Think(state, bot_input.actions);
+                } else {
+                    bot.Think(state, bot_input.actions);
+                }
+            }
+            return bot_input;
+        }
+        if (!script.empty()) {
+            return script[tick % script.size()];
+        }
+        random_input.actions.clear();
+        auto action = rng.Below(16);
+        if (action < static_cast<u32>(GameLogic::Action::SoftDrop)) {
+            random_input.actions.push_back(
+                static_cast<GameLogic::Action>(action));
+        }
+        random_input.accelerate = rng.Below(4) == 0;
+        return random_input;
+    }
+
+  private:
+    const std::vector<TickInput>& script;
+    bool use_bot = false;
+    GameLogic::RolloutBot* rollout_bot = nullptr;
+    GameLogic::BeamSearchBot* beam_bot = nullptr;
+    GameLogic::HeuristicBot bot;
+    TickInput bot_input;
+    Rng rng;
+    TickInput random_input;
+};
+
+struct BatchStats {
+    u64 games = 0;
+    u64 ticks = 0;
+    u64 pieces = 0;
+    f64 total_score = 0;
+    int best_score = 0;
+
+    void Add(const BatchStats& other) {
+        games += other.games;
+        ticks += other.ticks;
+        pieces += other.pieces;
+        total_score += other.total_score;
+        best_score = std::max(best_score, other.best_score);
+    }
+};
+
+// Play one game with the rules of processGameUpdate
+void PlayGame(u64 seed, const Options& options, Player& player,
+              BatchStats& stats) {
+    GameLogic::GameState state(seed, options.block_generator);
+    player.Reset(seed);
+
+    u32 tick = 0;
+    for (; tick < options.max_ticks &&
+           state.phase != GameLogic::GamePhase::Lost;
+         ++tick) {
+        const auto& input = player.Decide(tick, state);
+        auto phase = state.phase;
+        for (auto action : input.actions) {
+            GameLogic::Apply(state, action);
+        }
+        GameLogic::processGameUpdate(state, input.accelerate);
+        if (state.phase == GameLogic::GamePhase::NewBlockCreation &&
+            phase != GameLogic::GamePhase::NewBlockCreation) {
+            ++stats.pieces;
+        }
+    }
+    ++stats.games;
+    stats.ticks += tick;
+    stats.total_score += state.score;
+    stats.best_score = std::max(stats.best_score, state.score);
+}
+
+// Play all the games on a pool of the given size, returns the wall time
+f64 RunBatch(const Options& options, const std::vector<TickInput>& script,
+             u32 thread_count, BatchStats& stats) {
+    // one slot per worker, on its own cache line
+    struct alignas(64) WorkerSlot {
+        WorkerSlot(const std::vector<TickInput>& script, bool use_bot)
+            : player(script, use_bot) {}
+
+        Player player;
+        BatchStats stats;
+    };
+    std::vector<WorkerSlot> slots(thread_count,
+                                  WorkerSlot(script, options.bot));
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        ThreadPool pool(thread_count);
+        for (u32 first = 0; first < options.games; first += games_per_task) {
+            auto last = std::min(first + games_per_task, options.games);
+            pool.Submit([&, first, last](u32 worker) {
+                auto& slot = slots[worker];
+                for (auto game = first; game < last; ++game) {
+                    PlayGame(static_cast<u64>(options.seed) + game, options,
+                             slot.player, slot.stats);
+                }
+            });
+        }
+        pool.Wait();
+    }
+    std::chrono::duration<f64> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    for (const auto& slot : slots) {
+        stats.Add(slot.stats);
+    }
+    return std::max(elapsed.count(), 1e-9);
+}
+
+// Play the games one after the other with a bot which runs its search on
+// all the threads, and print the report but its search lines
+void PlayGamesInOrder(const Options& options, Player& player) {
+    BatchStats stats;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u32 game = 0; game < options.games; ++game) {
+        PlayGame(static_cast<u64>(options.seed) + game, options, player, stats);
+    }
+    std::chrono::duration<f64> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    auto seconds = std::max(elapsed.count(), 1e-9);
+    printf("games:        %llu\n",
+           static_cast<unsigned long long>(stats.games));
+    printf("threads:      %u\n", options.threads);
+    printf("pieces:       %llu\n",
+           static_cast<unsigned long long>(stats.pieces));
+    printf("avg score:    %.2f\n",
+           stats.total_score / std::max<u64>(stats.games, 1));
+    printf("best score:   %d\n", stats.best_score);
+    printf("time:         %.3f s\n", seconds);
+    printf("pieces/sec:   %.1f\n", stats.pieces / seconds);
+}
+
+int PlayRolloutGames(const Options& options,
+                     const std::vector<TickInput>& script) {
+    GameLogic::RolloutBot rollout_bot(GameLogic::RolloutLimits(),
+                                      GameLogic::BotWeights(),
+                                      options.threads);
+    Player player(script, false, &rollout_bot);
+    PlayGamesInOrder(options, player);
+
+    auto rollout_seconds =
+        std::max(rollout_bot.GetRolloutNanoseconds() * 1e-9, 1e-9);
+    printf("rollouts:     %llu\n",
+           static_cast<unsigned long long>(rollout_bot.GetRolloutCount()));
+    printf("rollouts/sec: %.1f\n",
+           rollout_bot.GetRolloutCount() / rollout_seconds);
+    return 0;
+}
+
+int PlayBeamGames(const Options& options,
+                  const std::vector<TickInput>& script) {
+    GameLogic::BeamSearchBot beam_bot(GameLogic::BeamSearchLimits(),
+                                      GameLogic::BotWeights(),
+                                      options.threads);
+    Player player(script, false, nullptr, &beam_bot);
+    PlayGamesInOrder(options, player);
+
+    auto search_seconds =
+        std::max(beam_bot.GetSearchNanoseconds() * 1e-9, 1e-9);
+    printf("nodes:        %llu\n",
+           static_cast<unsigned long long>(beam_bot.GetTotalNodeCount()));
+    printf("nodes/sec:    %.1f\n",
+           beam_bot.GetTotalNodeCount() / search_seconds);
+    return 0;
+}
+
+int PlayReplay(const Options& options) {
+    GameLogic::ReplayPlayer player;
+    if (!player.Open(options.replay_path.c_str())) {
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    player.Seek(options.seek_tick);
+    std::chrono::duration<f64> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    const auto& state = player.GetState();
+    auto seconds = std::max(elapsed.count(), 1e-9);
+    auto game_seconds =
+        state.tick / static_cast<f64>(Settings::logic_tick_rate_hz);
+    printf("seed:        %llu\n", static_cast<unsigned long long>(state.seed));
+    printf("tick:        %llu / %llu\n",
+           static_cast<unsigned long long>(state.tick),
+           static_cast<unsigned long long>(player.GetEndTick()));
+    printf("game time:   %.1f s\n", game_seconds);
+    printf("blocks:      %llu\n",
+           static_cast<unsigned long long>(player.GetBlockCount()));
+    printf("score:       %d\n", state.score);
+    printf("board hash:  %016llx\n",
+           static_cast<unsigned long long>(state.board.hash));
+    printf("lost:        %s\n",
+           state.phase == GameLogic::GamePhase::Lost ? "yes" : "no");
+    printf("time:        %.6f s\n", seconds);
+    printf("speed:       %.0fx real time\n", game_seconds / seconds);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    if (!options.replay_path.empty()) {
+        return PlayReplay(options);
+    }
+
+    std::vector<TickInput> script;
+    if (!options.script_path.empty()) {
+        std::ifstream file(options.script_path);
+        if (!file) {
+            printf("Failed to open script: %s\n", options.script_path.c_str());
+            return 1;
+        }
+        for (std::string line; std::getline(file, line);) {
+            script.push_back(DecodeScriptLine(line));
+        }
+    }
+
+    if (options.rollout) {
+        return PlayRolloutGames(options, script);
+    }
+    if (options.beam) {
+        return PlayBeamGames(options, script);
+    }
+
+    if (options.scaling) {
+        printf("threads  games/sec  pieces/sec  speedup  efficiency\n");
+        f64 single_thread_rate = 0;
+        for (u32 threads = 1;;
+             threads = std::min(threads * 2, options.threads)) {
+            BatchStats stats;
+            auto seconds = RunBatch(options, script, threads, stats);
+            auto rate = stats.games / seconds;
+            if (threads == 1) {
+                single_thread_rate = rate;
+            }
+            auto speedup = rate / single_thread_rate;
+            printf("%7u  %9.1f  %10.1f  %7.2f  %9.0f%%\n", threads, rate,
+                   stats.pieces / seconds, speedup, 100 * speedup / threads);
+            if (threads == options.threads) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    BatchStats stats;
+    auto seconds = RunBatch(options, script, options.threads, stats);
+    printf("games:       %llu\n", static_cast<unsigned long long>(stats.games));
+    printf("threads:     %u\n", options.threads);
+    printf("ticks:       %llu\n", static_cast<unsigned long long>(stats.ticks));
+    printf("pieces:      %llu\n",
+           static_cast<unsigned long long>(stats.pieces));
+    printf("avg score:   %.2f\n",
+           stats.total_score / std::max<u64>(stats.games, 1));
+    printf("best score:  %d\n", stats.best_score);
+    printf("time:        %.3f s\n", seconds);
+    printf("games/sec:   %.1f\n", stats.games / seconds);
+    printf("pieces/sec:  %.1f\n", stats.pieces / seconds);
+    printf("ticks/sec:   %.1f\n", stats.ticks / seconds);
+    return 0;
+}
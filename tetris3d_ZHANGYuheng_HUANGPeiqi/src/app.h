@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <stdio.h>
@@ -16,28 +17,41 @@ void OnFramebufferResize(GLFWwindow* window, i32 width, i32 height);
 void OnKeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action,
                    i32 mods);
 
+// Monotonic clock counting 64-bit nanoseconds, which stays exact for
+// centuries of uptime
 class Timer {
   public:
+    static u64 NowNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static std::chrono::steady_clock::time_point
+    ToTimePoint(u64 nanoseconds) {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds(nanoseconds)));
+    }
+
     void Tick() {
-        auto tick = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<f32> diff = tick - prev_tick;
-        elapsed_seconds = diff.count();
+        auto tick = NowNanoseconds();
+        elapsed_nanoseconds = tick - prev_tick;
         prev_tick = tick;
     }
 
-    f32 GetElapsedSeconds() const { return elapsed_seconds; }
+    u64 GetElapsedNanoseconds() const { return elapsed_nanoseconds; }
+
+    f32 GetElapsedSeconds() const { return elapsed_nanoseconds * 1e-9f; }
 
   private:
-    std::chrono::high_resolution_clock::time_point prev_tick =
-        std::chrono::high_resolution_clock::now();
-    f32 elapsed_seconds = 0.f;
+    u64 prev_tick = NowNanoseconds();
+    u64 elapsed_nanoseconds = 0;
 };
 
 class Tetris3DApp {
   public:
     void Run() {
-        using namespace std::literals::chrono_literals;
-
         if (!StartUp()) {
             return;
         }
@@ -52,17 +66,45 @@ class Tetris3DApp {
             game.OnFramebufferResize(framebuffer_width, framebuffer_height);
         }
 
+        const u64 nanoseconds_per_second = 1000000000;
+        const auto frame_nanoseconds =
+            Settings::graphics_frame_rate
+                ? nanoseconds_per_second / Settings::graphics_frame_rate
+                : 0;
+
+        // time not consumed by ticks yet, in 1 / (hz * 1e9) s so that the
+        // tick length is exact
+        u64 accumulator = 0;
+        auto next_frame = Timer::NowNanoseconds();
         timer.Tick();
         while (!glfwWindowShouldClose(window)) {
             input.Update();
             glfwPollEvents();
             timer.Tick();
-            game.Update(input, timer.GetElapsedSeconds());
+
+            accumulator +=
+                timer.GetElapsedNanoseconds() * Settings::logic_tick_rate_hz;
+            u32 ticks = 0;
+            while (accumulator >= nanoseconds_per_second &&
+                   ticks < Settings::logic_max_ticks_per_frame) {
+                accumulator -= nanoseconds_per_second;
+                ++ticks;
+            }
+            // drop the backlog we could not catch up with
+            accumulator = std::min(accumulator, nanoseconds_per_second);
+            game.Update(input, ticks);
 
             game.Draw();
             glfwSwapBuffers(window);
 
-            std::this_thread::sleep_for(16ms);
+            // pace the frames on deadlines, a late frame does not make the
+            // next ones come sooner
+            next_frame += frame_nanoseconds;
+            auto now = Timer::NowNanoseconds();
+            if (next_frame < now) {
+                next_frame = now;
+            }
+            std::this_thread::sleep_until(Timer::ToTimePoint(next_frame));
         }
     }
 
@@ -83,7 +125,6 @@ class Tetris3DApp {
     Game game;
 
     bool StartUp() {
-        srand(time(nullptr));
         glfwInit();
 
         if (Settings::graphics_renderer_type == Settings::RendererType::Basic) {
@@ -0,0 +1,219 @@
+#include "beam_search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+#include "symmetry.h"
+#include "zobrist.h"
+
+namespace GameLogic {
+
+namespace {
+
+// value of the boards where the next block cannot appear
+const f32 lost_value = std::numeric_limits<f32>::lowest();
+
+u64 NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Key of the block count in the hashes, the boards after a given count of
+// blocks have the same blocks to come
+u64 DepthKey(u32 depth) {
+    u64 seed = depth;
+    return detail::NextZobristKey(seed);
+}
+
+// Hash of the filled cells once the block is merged, before its layers are
+// erased. The same cells erase the same layers, so the hash tells the
+// landed boards apart without landing them.
+u64 HashMerged(const Board3D& board, const Block& block) {
+    auto hash = board.hash;
+    for (auto& offset : block.cube_offsets) {
+        auto position = block.position + offset;
+        hash ^= ZobristCellKey(board.LayerBit(position), position.y);
+    }
+    return hash;
+}
+
+} // namespace
+
+BeamSearchBot::BeamSearchBot(const BeamSearchLimits& limits,
+                             const BotWeights& weights, u32 thread_count)
+    : limits(limits), weights(weights), pool(thread_count) {
+    for (u32 i = 0; i <= pool.GetThreadCount(); ++i) {
+        workers.push_back(std::make_unique<Worker>(weights));
+    }
+}
+
+bool BeamSearchBot::Think(const GameState& state,
+                          std::vector<Action>& actions) {
+    start_time = NowNanoseconds();
+    nodes = 0;
+    out_of_budget = false;
+    searched_blocks = 0;
+    // room for the children kept by every board of every block
+    table.Reset(static_cast<size_t>(limits.beam_width) *
+                (1 + limits.beam_width * limits.omniscient_blocks));
+
+    // the falling block is always searched, whatever the budget
+    auto& root_worker = *workers.back();
+    Node root;
+    root.state = state;
+    beam.clear();
+    children.resize(1);
+    Expand(root, 0, 0, root_worker, children[0]);
+
+    u32 best_root = 0;
+    while (true) {
+        // the boards which own their hash, best first
+        std::vector<const Node*> candidates;
+        for (auto& siblings : children) {
+            for (auto& child : siblings) {
+                u64 owner = 0;
+                if (!table.Find(child.hash, owner) || owner == child.id) {
+                    candidates.push_back(&child);
+                }
+            }
+        }
+        if (candidates.empty()) {
+            break;
+        }
+        auto kept = std::min<size_t>(candidates.size(), limits.beam_width);
+        std::partial_sort(candidates.begin(), candidates.begin() + kept,
+                          candidates.end(), [](const Node* a, const Node* b) {
+                              return a->value > b->value ||
+                                     (a->value == b->value && a->id < b->id);
+                          });
+        best_root = candidates[0]->root;
+        ++searched_blocks;
+
+        std::vector<Node> next_beam(kept);
+        for (size_t i = 0; i < kept; ++i) {
+            next_beam[i] = *candidates[i];
+        }
+        beam.swap(next_beam);
+
+        if (searched_blocks > limits.omniscient_blocks || OutOfBudget()) {
+            break;
+        }
+
+        auto width = static_cast<u32>(beam.size());
+        auto depth = searched_blocks;
+        children.resize(width);
+        for (u32 i = 0; i < width; ++i) {
+            children[i].clear();
+            pool.Submit([this, i, depth](u32 worker) {
+                if (!OutOfBudget()) {
+                    Expand(beam[i], i, depth, *workers[worker], children[i]);
+                }
+            });
+        }
+        pool.Wait();
+        // NOTE: a block cut short left boards unexpanded, its best board is
+        // not comparable with the ones of the finished blocks
+        if (out_of_budget) {
+            break;
+        }
+    }
+    node_count = nodes;
+    total_node_count += node_count;
+    search_nanoseconds += NowNanoseconds() - start_time;
+
+    if (searched_blocks == 0) {
+        return false;
+    }
+    const auto& placements = root_worker.search.GetPlacements();
+    root_worker.search.GetActions(placements[best_root], actions);
+    return true;
+}
+
+void BeamSearchBot::Expand(const Node& parent, u32 parent_index, u32 depth,
+                           Worker& worker, std::vector<Node>& children) {
+    children.clear();
+    const auto& placements = worker.search.Run(parent.state);
+    auto count = placements.size();
+    nodes.fetch_add(count, std::memory_order_relaxed);
+    if (count == 0) {
+        return;
+    }
+    worker.bot.ExtractFeatures(parent.state, placements, worker.features);
+    worker.bot.Score(worker.features, worker.scores);
+
+    // no more than beam_width children of a board can make it to the beam
+    const auto& scores = worker.scores;
+    auto& order = worker.order;
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0);
+    auto kept = std::min<size_t>(count, limits.beam_width);
+    std::partial_sort(order.begin(), order.begin() + kept, order.end(),
+                      [&](u32 a, u32 b) {
+                          return scores[a] > scores[b] ||
+                                 (scores[a] == scores[b] && a < b);
+                      });
+
+    auto depth_key = DepthKey(depth);
+    for (size_t rank = 0; rank < kept; ++rank) {
+        auto i = order[rank];
+        auto id = static_cast<u64>(parent_index) << 32 | rank;
+        auto block = placements[i].Place(parent.state.falling_block);
+
+        // NOTE: a board with a lower id in the table is left out now, the
+        // ones with a higher id when the beam is picked. The boards which
+        // are kept do not depend on the thread timing.
+        u64 owner = 0;
+        u64 hash = 0;
+        if (!limits.merge_symmetric_boards) {
+            hash = HashMerged(parent.state.board, block) ^ depth_key;
+            if (table.Find(hash, owner) && owner < id) {
+                continue;
+            }
+        }
+
+        children.emplace_back();
+        auto& child = children.back();
+        child.state = parent.state;
+        child.state.falling_block = block;
+        auto erased = LandFallingBlock(child.state);
+        // the canonical hash needs the landed board
+        if (limits.merge_symmetric_boards) {
+            hash = GetCanonicalHash(child.state.board) ^ depth_key;
+            if (table.Find(hash, owner) && owner < id) {
+                children.pop_back();
+                continue;
+            }
+        }
+
+        // the score of the placement counts its cleared layers
+        child.value = parent.cleared_value + scores[i];
+        child.cleared_value =
+            parent.cleared_value + weights.layers_cleared * erased;
+        if (!child.state.falling_block.IsValid(child.state.board)) {
+            child.value = lost_value;
+        }
+        child.root = depth == 0 ? i : parent.root;
+        child.id = id;
+        child.hash = hash;
+        table.Insert(child.hash, child.id);
+    }
+}
+
+bool BeamSearchBot::OutOfBudget() {
+    if (out_of_budget.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if ((limits.max_nodes &&
+         nodes.load(std::memory_order_relaxed) >= limits.max_nodes) ||
+        (limits.max_nanoseconds &&
+         NowNanoseconds() - start_time >= limits.max_nanoseconds)) {
+        out_of_budget.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+}
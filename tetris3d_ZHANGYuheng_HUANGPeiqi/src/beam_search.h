@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "bot.h"
+#include "common.h"
+#include "logic.h"
+#include "placement.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+
+namespace GameLogic {
+
+// Size and budget of a beam search. The search goes one block deeper at a
+// time and answers from the deepest block it finished, so running out of
+// budget only makes it shallower.
+struct BeamSearchLimits {
+    // boards kept after each block
+    u32 beam_width = 16;
+    // blocks searched after the falling one. They are dealt from the
+    // random stream of the game, which the player does not see.
+    u32 omniscient_blocks = 2;
+    // placements scored at most, 0 for no limit
+    u64 max_nodes = 0;
+    // time the search may take, 0 for no limit
+    u64 max_nanoseconds = 0;
+    // keep one of the boards which are mirror images or rotations of each
+    // other, see FindCanonicalSymmetry. The heuristic scores them the same,
+    // but the boards are landed before they can be merged.
+    bool merge_symmetric_boards = false;
+};
+
+// Lookahead player: places the falling block and the next ones, keeping the
+// beam_width best boards after each block, and plays the first placement of
+// the best board found.
+//
+// The search is omniscient: the boards are GameState snapshots landed with
+// LandFallingBlock, which deals the next blocks from the random stream of
+// the game. The game shows no preview, so the bot knows blocks a player
+// does not, and its results are an upper bound for the lookahead.
+//
+// The boards of a block are expanded in parallel, one task each, and are
+// scored by the features of HeuristicBot. A transposition table shared by
+// the tasks for the whole search, keyed by the hash of the board with the
+// block merged and by the block count, keeps a single copy of the boards
+// reached by placing the blocks in different spots. A board already in the
+// table is neither landed nor expanded again.
+class BeamSearchBot {
+  public:
+    explicit BeamSearchBot(
+        const BeamSearchLimits& limits = BeamSearchLimits(),
+        const BotWeights& weights = BotWeights(),
+        u32 thread_count = ThreadPool::DefaultThreadCount());
+
+    // Actions bringing the falling block to its best placement and landing
+    // it, false when it has nowhere to go
+    bool Think(const GameState& state, std::vector<Action>& actions);
+
+    // Blocks searched and placements scored by the last Think
+    u32 GetSearchedBlocks() const { return searched_blocks; }
+    u64 GetNodeCount() const { return node_count; }
+
+    // Placements scored and the search time, since the creation of the bot
+    u64 GetTotalNodeCount() const { return total_node_count; }
+    u64 GetSearchNanoseconds() const { return search_nanoseconds; }
+
+  private:
+    struct Node {
+        GameState state;
+        // score of the board plus the layers cleared on the way to it
+        f32 value = 0.f;
+        f32 cleared_value = 0.f;
+        // placement of the falling block this board comes from
+        u32 root = 0;
+        // parent index and rank among its siblings, orders the equal boards
+        u64 id = 0;
+        // key in the transposition table
+        u64 hash = 0;
+    };
+
+    // Buffers of a thread
+    struct Worker {
+        explicit Worker(const BotWeights& weights) : bot(weights) {}
+
+        HeuristicBot bot;
+        PlacementSearch search;
+        PlacementFeatures features;
+        std::vector<f32> scores;
+        std::vector<u32> order;
+    };
+
+    // Set children to the best children of the beam node, but the ones
+    // already in the table with a lower id. depth is the block count of the
+    // children.
+    void Expand(const Node& parent, u32 parent_index, u32 depth,
+                Worker& worker, std::vector<Node>& children);
+    bool OutOfBudget();
+
+    BeamSearchLimits limits;
+    BotWeights weights;
+    ThreadPool pool;
+    // one per pool thread, and the last one for the placements of the
+    // falling block
+    std::vector<std::unique_ptr<Worker>> workers;
+    TranspositionTable table;
+    std::vector<Node> beam;
+    // children of every beam node
+    std::vector<std::vector<Node>> children;
+
+    u64 start_time = 0;
+    std::atomic<u64> nodes{0};
+    std::atomic<bool> out_of_budget{false};
+    u32 searched_blocks = 0;
+    u64 node_count = 0;
+    u64 total_node_count = 0;
+    u64 search_nanoseconds = 0;
+};
+
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "common.h"
+#include "orientation.h"
+
+namespace GameLogic {
+
+// Occupancy of one horizontal layer of the board, one bit per cell.
+// Bits [0, 64) live in lo and bits [64, 128) in hi.
+//
+// Cell (x, z) uses bit x * row_stride + z where row_stride = depth + 1.
+// The spare column z = depth and every bit past the last row are guard
+// bits which are always set, so a block sticking out of the board on the
+// +x or +z side collides with them like with any other cube.
+struct LayerMask {
+    u64 lo = 0;
+    u64 hi = 0;
+
+    constexpr void Set(u32 bit) {
+        if (bit < 64) {
+            lo |= u64(1) << bit;
+        } else {
+            hi |= u64(1) << (bit - 64);
+        }
+    }
+
+    constexpr void Clear(u32 bit) {
+        if (bit < 64) {
+            lo &= ~(u64(1) << bit);
+        } else {
+            hi &= ~(u64(1) << (bit - 64));
+        }
+    }
+
+    constexpr bool Test(u32 bit) const {
+        return bit < 64 ? (lo >> bit) & 1 : (hi >> (bit - 64)) & 1;
+    }
+
+    constexpr bool Intersects(const LayerMask& other) const {
+        return (lo & other.lo) | (hi & other.hi);
+    }
+
+    constexpr LayerMask ShiftedLeft(u32 shift) const {
+        if (!shift) {
+            return *this;
+        }
+        if (shift >= 128) {
+            return LayerMask{};
+        }
+        if (shift >= 64) {
+            return LayerMask{0, lo << (shift - 64)};
+        }
+        return LayerMask{lo << shift, (hi << shift) | (lo >> (64 - shift))};
+    }
+
+    constexpr LayerMask ShiftedRight(u32 shift) const {
+        if (!shift) {
+            return *this;
+        }
+        if (shift >= 128) {
+            return LayerMask{};
+        }
+        if (shift >= 64) {
+            return LayerMask{hi >> (shift - 64), 0};
+        }
+        return LayerMask{(lo >> shift) | (hi << (64 - shift)), hi >> shift};
+    }
+
+    // Left for a positive shift, right for a negative one
+    constexpr LayerMask Shifted(i32 shift) const {
+        return shift >= 0 ? ShiftedLeft(static_cast<u32>(shift))
+                          : ShiftedRight(static_cast<u32>(-shift));
+    }
+
+    constexpr LayerMask operator&(const LayerMask& other) const {
+        return LayerMask{lo & other.lo, hi & other.hi};
+    }
+    constexpr LayerMask operator|(const LayerMask& other) const {
+        return LayerMask{lo | other.lo, hi | other.hi};
+    }
+    constexpr LayerMask operator~() const { return LayerMask{~lo, ~hi}; }
+
+    constexpr bool operator==(const LayerMask& other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+    constexpr bool operator!=(const LayerMask& other) const {
+        return !(*this == other);
+    }
+
+    // Empty layer of a width x depth board: only the guard bits are set
+    static constexpr LayerMask EmptyLayer(u32 width, u32 depth) {
+        LayerMask mask;
+        auto row_stride = depth + 1;
+        for (u32 x = 0; x < width; ++x) {
+            mask.Set(x * row_stride + depth);
+        }
+        for (u32 bit = width * row_stride; bit < 128; ++bit) {
+            mask.Set(bit);
+        }
+        return mask;
+    }
+
+    // Whether the guard bits of a width x depth board catch every block
+    // anchored inside the padded area (see PieceMask)
+    static constexpr bool FitsBoard(u32 width, u32 depth) {
+        return width * (depth + 1) + depth + 3 < 128;
+    }
+};
+
+// Cubes of one block orientation as layer masks, relative to the minimum
+// corner of the block. Testing a block is shifting layers[i] by the bit of
+// the corner and intersecting it with the board layer corner.y + i.
+struct PieceMask {
+    CubeOffset min;
+    u32 layer_count = 0;
+    LayerMask layers[4];
+};
+
+// Piece masks of all the orientations of all the block types, for boards
+// with the given row stride
+struct PieceMaskTable {
+    PieceMask masks[block_type_count + 1][block_max_orientations];
+};
+
+namespace detail {
+
+constexpr PieceMask MakePieceMask(const OrientationTable& table,
+                                  u32 orientation, u32 row_stride) {
+    PieceMask mask;
+    if (!table.cube_count) {
+        return mask;
+    }
+
+    const auto* cubes = table.cubes[orientation];
+    mask.min = cubes[0];
+    i8 max_y = cubes[0].y;
+    for (u32 i = 1; i < table.cube_count; ++i) {
+        mask.min.x = cubes[i].x < mask.min.x ? cubes[i].x : mask.min.x;
+        mask.min.y = cubes[i].y < mask.min.y ? cubes[i].y : mask.min.y;
+        mask.min.z = cubes[i].z < mask.min.z ? cubes[i].z : mask.min.z;
+        max_y = cubes[i].y > max_y ? cubes[i].y : max_y;
+    }
+    mask.layer_count = max_y - mask.min.y + 1;
+
+    for (u32 i = 0; i < table.cube_count; ++i) {
+        auto x = static_cast<u32>(cubes[i].x - mask.min.x);
+        auto z = static_cast<u32>(cubes[i].z - mask.min.z);
+        mask.layers[cubes[i].y - mask.min.y].Set(x * row_stride + z);
+    }
+    return mask;
+}
+
+constexpr PieceMaskTable MakePieceMaskTable(u32 row_stride) {
+    PieceMaskTable table;
+    for (u32 type = 0; type <= block_type_count; ++type) {
+        const auto& orientations = orientation_tables[type];
+        for (u32 i = 0; i < orientations.orientation_count; ++i) {
+            table.masks[type][i] =
+                MakePieceMask(orientations, i, row_stride);
+        }
+    }
+    return table;
+}
+
+} // namespace detail
+
+template <u32 RowStride>
+inline constexpr PieceMaskTable piece_mask_tables =
+    detail::MakePieceMaskTable(RowStride);
+
+} // namespace GameLogic
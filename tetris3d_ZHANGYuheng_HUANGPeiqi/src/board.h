@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+
+#include "bitboard.h"
+#include "common.h"
+#include "glm/vec3.hpp"
+#include "orientation.h"
+#include "settings.h"
+#include "zobrist.h"
+
+namespace GameLogic {
+
+// Dimensions of a board. With non-zero template arguments they are compile
+// time constants, with <0, 0, 0> they are given at run time.
+template <u32 W, u32 D, u32 H> struct BoardExtents {
+    static_assert(LayerMask::FitsBoard(W, D),
+                  "a layer and its guard bits have to fit in one LayerMask");
+    static_assert(H < 256, "column heights are stored in bytes");
+
+    BoardExtents([[maybe_unused]] u32 _width, [[maybe_unused]] u32 _depth,
+                 [[maybe_unused]] u32 _height) {
+        assert(_width == W && _depth == D && _height == H);
+    }
+
+    static constexpr u32 width = W;
+    static constexpr u32 depth = D;
+    static constexpr u32 height = H;
+    static constexpr LayerMask empty_layer = LayerMask::EmptyLayer(W, D);
+};
+
+template <> struct BoardExtents<0, 0, 0> {
+    BoardExtents(u32 _width, u32 _depth, u32 _height)
+        : width(_width), depth(_depth), height(_height),
+          empty_layer(LayerMask::EmptyLayer(_width, _depth)) {
+        // a layer and its guard bits have to fit in one LayerMask
+        assert(LayerMask::FitsBoard(width, depth));
+        // column heights are stored in bytes
+        assert(height < 256);
+    }
+
+    // NOTE: not const so that boards can be assigned, they never change
+    u32 width = 0;
+    u32 depth = 0;
+    u32 height = 0;
+    LayerMask empty_layer;
+};
+
+// Fixed boards keep everything inline, dynamic boards on the heap
+template <typename T, u32 N>
+using BoardArray =
+    std::conditional_t<N == 0, std::vector<T>, std::array<T, N>>;
+template <typename T, u32 N>
+using BoardList =
+    std::conditional_t<N == 0, std::vector<T>, InlineVector<T, N>>;
+
+template <typename T>
+void ResetBoardArray(std::vector<T>& array, size_t size, const T& value) {
+    array.assign(size, value);
+}
+
+template <typename T, size_t N>
+void ResetBoardArray(std::array<T, N>& array, [[maybe_unused]] size_t size,
+                     const T& value) {
+    assert(size == N);
+    array.fill(value);
+}
+
+template <u32 W = 0, u32 D = 0, u32 H = 0>
+class BasicBoard3D : public BoardExtents<W, D, H> {
+    using Extents = BoardExtents<W, D, H>;
+
+  public:
+    using Extents::depth;
+    using Extents::empty_layer;
+    using Extents::height;
+    using Extents::width;
+
+    static constexpr bool is_fixed_size = W != 0;
+
+    // Create a board
+    BasicBoard3D(u32 _width = W ? W : Settings::map_width,
+                 u32 _depth = D ? D : Settings::map_depth,
+                 u32 _height = H ? H : Settings::map_height)
+        : Extents(_width, _depth, _height) {
+        ResetBoardArray(cells, width * depth * height, u8(0));
+        ResetBoardArray(layers, height, empty_layer);
+        ResetBoardArray(layer_fill_counts, height, u8(0));
+        ResetBoardArray(layer_hashes, height, u64(0));
+        ResetBoardArray(layer_dirty, height, u8(0));
+        ResetBoardArray(column_heights, width * depth, u8(0));
+    }
+
+    // Fill the board with block
+    void Fill(const glm::ivec3& position, u8 value) {
+        auto index = PositionToIndex(position);
+        cells[index] = value;
+
+        auto& layer = layers[position.y];
+        auto bit = LayerBit(position);
+        if (value && !layer.Test(bit)) {
+            layer.Set(bit);
+            ++layer_fill_counts[position.y];
+            MarkLayerDirty(position.y);
+        } else if (!value && layer.Test(bit)) {
+            layer.Clear(bit);
+            --layer_fill_counts[position.y];
+        } else {
+            return;
+        }
+        layer_hashes[position.y] ^= zobrist_keys.cells[bit];
+        hash ^= ZobristCellKey(bit, position.y);
+
+        auto& column_height = column_heights[ColumnIndex(position)];
+        if (value) {
+            column_height =
+                std::max(column_height, static_cast<u8>(position.y + 1));
+        } else if (column_height == position.y + 1) {
+            column_height = static_cast<u8>(
+                TopOfColumn(position.x, position.z, position.y));
+        }
+        ++revision;
+    }
+
+    // Check if the position is empty
+    bool IsEmpty(const glm::ivec3& position) const {
+        return !layers[position.y].Test(LayerBit(position));
+    }
+
+    // Check if the position is filled
+    bool Contains(const glm::ivec3& position) const {
+        if (position.x < 0 || position.y < 0 || position.z < 0 ||
+            position.x >= static_cast<i32>(width) ||
+            position.y >= static_cast<i32>(height) ||
+            position.z >= static_cast<i32>(depth)) {
+            return false;
+        }
+        return true;
+    }
+
+    // Index of the cell; a layer is a contiguous run of width * depth cells
+    size_t PositionToIndex(const glm::ivec3& position) const {
+        return ColumnIndex(position) +
+               static_cast<size_t>(position.y) * width * depth;
+    }
+
+    // Bit of the position inside its layer mask
+    u32 LayerBit(const glm::ivec3& position) const {
+        return position.x * (depth + 1) + position.z;
+    }
+
+    u32 ColumnIndex(const glm::ivec3& position) const {
+        return position.x * depth + position.z;
+    }
+
+    // Height of the highest filled cell of the column plus one, 0 when the
+    // column is empty
+    u32 GetColumnHeight(i32 x, i32 z) const {
+        return column_heights[x * depth + z];
+    }
+
+    // Precomputed layer masks of a block orientation laid out for this
+    // board, or nullptr for a dynamic board without a table for its depth
+    const PieceMask* GetPieceMask(BlockType type, u32 orientation) const {
+        if constexpr (is_fixed_size) {
+            return &piece_mask_tables<D + 1>
+                        .masks[static_cast<u32>(type)][orientation];
+        } else {
+            if (depth != Settings::map_depth) {
+                return nullptr;
+            }
+            return &piece_mask_tables<Settings::map_depth + 1>
+                        .masks[static_cast<u32>(type)][orientation];
+        }
+    }
+
+    // when layer is filled, erase the layer and return the number of filled layers
+    // NOTE: only layers that gained cells since the last call can be filled,
+    // so nothing is scanned when no block was merged
+    // erased_layers receives the erased layers in ascending order, as they
+    // were numbered before the erase
+    u32 EraseFilledLayers(std::vector<u32>* erased_layers = nullptr) {
+        if (dirty_layers.empty()) {
+            return 0;
+        }
+
+        BoardList<u32, H> filled;
+        for (auto layer : dirty_layers) {
+            if (IsLayerFilled(layer)) {
+                filled.push_back(layer);
+            }
+        }
+        ClearDirtyLayers();
+
+        std::sort(filled.begin(), filled.end());
+        auto filled_layers = static_cast<u32>(filled.size());
+        EraseLayers(filled.data(), filled_layers);
+        if (erased_layers) {
+            erased_layers->assign(filled.begin(), filled.end());
+        }
+        return filled_layers;
+    }
+
+    void EraseLayer(u32 layer) { EraseLayers(&layer, 1); }
+
+    // Erase the given layers (sorted ascending) and move the layers above
+    // them down in one pass, whole runs of layers at a time
+    void EraseLayers(const u32* erased, u32 count) {
+        if (!count) {
+            return;
+        }
+
+        // the layers from the first erased one up change their keys
+        for (auto y = erased[0]; y < height; ++y) {
+            hash ^= RotateLeft(layer_hashes[y], y);
+        }
+        CompactLayers(cells.data(), width * depth, erased, count);
+        CompactLayers(layers.data(), 1, erased, count, empty_layer);
+        CompactLayers(layer_fill_counts.data(), 1, erased, count);
+        CompactLayers(layer_hashes.data(), 1, erased, count);
+        for (auto y = erased[0]; y < height; ++y) {
+            hash ^= RotateLeft(layer_hashes[y], y);
+        }
+
+        // the dirty layers above follow their cells down
+        CompactLayers(layer_dirty.data(), 1, erased, count);
+        auto dirty_count = 0U;
+        for (auto layer : dirty_layers) {
+            auto erased_below = std::lower_bound(erased, erased + count, layer);
+            if (erased_below != erased + count && *erased_below == layer) {
+                continue;
+            }
+            dirty_layers[dirty_count++] =
+                layer - static_cast<u32>(erased_below - erased);
+        }
+        dirty_layers.resize(dirty_count);
+
+        // columns drop by the erased layers below their top, and further
+        // down when the top itself was erased
+        for (u32 x = 0; x < width; ++x) {
+            for (u32 z = 0; z < depth; ++z) {
+                auto& column_height = column_heights[x * depth + z];
+                auto erased_below =
+                    std::lower_bound(erased, erased + count, column_height) -
+                    erased;
+                column_height = static_cast<u8>(TopOfColumn(
+                    x, z, column_height - static_cast<u32>(erased_below)));
+            }
+        }
+        ++revision;
+    }
+
+    bool IsLayerFilled(u32 layer) const {
+        return layer_fill_counts[layer] == width * depth;
+    }
+
+    void MarkLayerDirty(u32 layer) {
+        if (!layer_dirty[layer]) {
+            layer_dirty[layer] = 1;
+            dirty_layers.push_back(layer);
+        }
+    }
+
+    void ClearDirtyLayers() {
+        for (auto layer : dirty_layers) {
+            layer_dirty[layer] = 0;
+        }
+        dirty_layers.clear();
+    }
+
+    // Height of the column when nothing is filled from layer below upwards
+    u32 TopOfColumn(i32 x, i32 z, u32 below) const {
+        auto bit = LayerBit(glm::ivec3(x, 0, z));
+        while (below > 0 && !layers[below - 1].Test(bit)) {
+            --below;
+        }
+        return below;
+    }
+
+    // palette indices of the cells, 0 for empty
+    BoardArray<u8, W * D * H> cells;
+    // occupancy bitboard, one mask per layer
+    BoardArray<LayerMask, H> layers;
+    // number of filled cells in each layer, a layer has less than 128 cells
+    // (see LayerMask::FitsBoard)
+    BoardArray<u8, H> layer_fill_counts;
+    // xor of the Zobrist keys of the filled cells of every layer, before
+    // their rotation by the layer
+    BoardArray<u64, H> layer_hashes;
+    // layers which gained cells since the last EraseFilledLayers
+    BoardArray<u8, H> layer_dirty;
+    BoardList<u32, H> dirty_layers;
+    // height of every (x, z) column, see GetColumnHeight
+    BoardArray<u8, W * D> column_heights;
+    // incremented on every change of the cells
+    u32 revision = 0;
+    // Zobrist hash of the filled cells, see ZobristKeys. The colors are
+    // left out, equal hashes mean the same cells are filled.
+    u64 hash = 0;
+
+  private:
+    // Per-layer array compaction shared by the cells and the layer data.
+    // Each run of kept layers between two erased ones is moved with a single
+    // copy and the freed layers at the top are reset to empty.
+    template <typename T>
+    void CompactLayers(T* data, size_t layer_size, const u32* erased,
+                       u32 count, const T& empty = T{}) {
+        auto dst = data + erased[0] * layer_size;
+        for (u32 i = 0; i < count; ++i) {
+            auto run_begin = erased[i] + 1;
+            auto run_end = i + 1 < count ? erased[i + 1] : height;
+            dst = std::copy(data + run_begin * layer_size,
+                            data + run_end * layer_size, dst);
+        }
+        std::fill(dst, data + height * layer_size, empty);
+    }
+};
+
+// Board of the game, with the dimensions of the settings fixed at compile
+// time so that the index computations and layer loops fold to constants
+using Board3D = BasicBoard3D<Settings::map_width, Settings::map_depth,
+                             Settings::map_height>;
+// Board with dimensions chosen at run time
+using DynamicBoard3D = BasicBoard3D<>;
+
+} // namespace GameLogic
@@ -0,0 +1,160 @@
+#include "bot.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace GameLogic {
+
+namespace {
+
+// placements handled by one run of the feature loops
+const u32 feature_lanes = 16;
+
+} // namespace
+
+void PlacementFeatures::Resize(size_t count) {
+    aggregate_height.assign(count, 0.f);
+    holes.assign(count, 0.f);
+    bumpiness.assign(count, 0.f);
+    wells.assign(count, 0.f);
+    layers_cleared.assign(count, 0.f);
+}
+
+void HeuristicBot::ExtractFeatures(const GameState& state,
+                                   const std::vector<Placement>& placements,
+                                   PlacementFeatures& features) {
+    const auto& board = state.board;
+    const auto width = Board3D::width;
+    const auto depth = Board3D::depth;
+    const auto height = Board3D::height;
+    const auto column_count = width * depth;
+    auto count = placements.size();
+    features.Resize(count);
+    // columns are padded to whole runs of lanes
+    auto stride = (count + feature_lanes - 1) / feature_lanes * feature_lanes;
+    heights.resize(column_count * stride);
+
+    auto filled_cells = 0U;
+    for (u32 y = 0; y < height; ++y) {
+        filled_cells += board.layer_fill_counts[y];
+    }
+    for (u32 column = 0; column < column_count; ++column) {
+        std::fill_n(heights.data() + column * stride, stride,
+                    board.column_heights[column]);
+    }
+
+    // a placement only raises the few columns under its cubes, unless it
+    // clears layers and the board is played out to get the new heights
+    for (size_t i = 0; i < count; ++i) {
+        auto block = placements[i].Place(state.falling_block);
+        u8 layer_cubes[height] = {};
+        auto cleared = 0U;
+        for (auto& offset : block.cube_offsets) {
+            auto cube = block.position + offset;
+            auto& column_height = heights[board.ColumnIndex(cube) * stride + i];
+            column_height =
+                std::max(column_height, static_cast<u8>(cube.y + 1));
+            if (board.layer_fill_counts[cube.y] + ++layer_cubes[cube.y] ==
+                column_count) {
+                ++cleared;
+            }
+        }
+
+        if (cleared) {
+            auto cleared_board = board;
+            for (auto& offset : block.cube_offsets) {
+                cleared_board.Fill(block.position + offset, block.color);
+            }
+            cleared_board.EraseFilledLayers();
+            for (u32 column = 0; column < column_count; ++column) {
+                heights[column * stride + i] =
+                    cleared_board.column_heights[column];
+            }
+        }
+
+        features.layers_cleared[i] = static_cast<f32>(cleared);
+        // the holes are the cells under the tops which are not filled, the
+        // heights are added below
+        features.holes[i] = -static_cast<f32>(
+            filled_cells + block.cube_offsets.size() - cleared * column_count);
+    }
+
+    // NOTE: the placements go by runs of lanes summed in local arrays, fixed
+    // size loops which the compiler vectorizes even at -O2
+    walls.assign(stride, static_cast<u8>(height));
+    for (size_t first = 0; first < stride; first += feature_lanes) {
+        i32 aggregate_height[feature_lanes] = {};
+        i32 bumpiness[feature_lanes] = {};
+        i32 wells[feature_lanes] = {};
+        for (u32 x = 0; x < width; ++x) {
+            for (u32 z = 0; z < depth; ++z) {
+                const auto* column =
+                    heights.data() + (x * depth + z) * stride + first;
+                const auto* left = x > 0 ? column - depth * stride
+                                         : walls.data() + first;
+                const auto* right = x + 1 < width ? column + depth * stride
+                                                  : walls.data() + first;
+                const auto* back =
+                    z > 0 ? column - stride : walls.data() + first;
+                const auto* front =
+                    z + 1 < depth ? column + stride : walls.data() + first;
+
+                for (u32 lane = 0; lane < feature_lanes; ++lane) {
+                    aggregate_height[lane] += column[lane];
+                    auto lowest =
+                        std::min(std::min(left[lane], right[lane]),
+                                 std::min(back[lane], front[lane]));
+                    wells[lane] += std::max(lowest - column[lane], 0);
+                }
+                // every pair of neighbours is counted once
+                if (x + 1 < width) {
+                    for (u32 lane = 0; lane < feature_lanes; ++lane) {
+                        bumpiness[lane] += std::abs(column[lane] - right[lane]);
+                    }
+                }
+                if (z + 1 < depth) {
+                    for (u32 lane = 0; lane < feature_lanes; ++lane) {
+                        bumpiness[lane] += std::abs(column[lane] - front[lane]);
+                    }
+                }
+            }
+        }
+
+        auto lanes = std::min<size_t>(feature_lanes, count - first);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            auto i = first + lane;
+            features.aggregate_height[i] =
+                static_cast<f32>(aggregate_height[lane]);
+            features.holes[i] += static_cast<f32>(aggregate_height[lane]);
+            features.bumpiness[i] = static_cast<f32>(bumpiness[lane]);
+            features.wells[i] = static_cast<f32>(wells[lane]);
+        }
+    }
+}
+
+void HeuristicBot::Score(const PlacementFeatures& features,
+                         std::vector<f32>& scores) const {
+    auto count = features.Size();
+    scores.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        scores[i] = weights.aggregate_height * features.aggregate_height[i] +
+                    weights.holes * features.holes[i] +
+                    weights.bumpiness * features.bumpiness[i] +
+                    weights.wells * features.wells[i] +
+                    weights.layers_cleared * features.layers_cleared[i];
+    }
+}
+
+bool HeuristicBot::Think(const GameState& state, std::vector<Action>& actions) {
+    const auto& placements = search.Run(state);
+    if (placements.empty()) {
+        return false;
+    }
+    ExtractFeatures(state, placements, features);
+    Score(features, scores);
+    auto best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+    search.GetActions(placements[best], actions);
+    return true;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "logic.h"
+#include "placement.h"
+
+namespace GameLogic {
+
+// Weights of the placement features, the score of a placement is their
+// weighted sum and the bot plays the highest score
+struct BotWeights {
+    f32 aggregate_height = -0.51f;
+    f32 holes = -0.36f;
+    f32 bumpiness = -0.18f;
+    f32 wells = -0.1f;
+    f32 layers_cleared = 0.76f;
+};
+
+// Features of the board left by each placement of a batch. Every feature is
+// an array over the placements, so the extraction and scoring loops run
+// over the placements and vectorize.
+struct PlacementFeatures {
+    void Resize(size_t count);
+    size_t Size() const { return aggregate_height.size(); }
+
+    // sum of the column heights
+    std::vector<f32> aggregate_height;
+    // empty cells under the top of their column
+    std::vector<f32> holes;
+    // height differences between the columns and their +x and +z
+    // neighbours
+    std::vector<f32> bumpiness;
+    // depth of the columns lower than all four neighbours, the walls count
+    // as full height
+    std::vector<f32> wells;
+    std::vector<f32> layers_cleared;
+};
+
+// Greedy player: scores every placement of the falling block by the board
+// it leaves and plays the best one through the actions of Apply
+class HeuristicBot {
+  public:
+    explicit HeuristicBot(const BotWeights& weights = BotWeights())
+        : weights(weights) {}
+
+    // Features of the placements of the falling block of state
+    void ExtractFeatures(const GameState& state,
+                         const std::vector<Placement>& placements,
+                         PlacementFeatures& features);
+    void Score(const PlacementFeatures& features,
+               std::vector<f32>& scores) const;
+
+    // Actions bringing the falling block to its best placement and landing
+    // it, false when it has nowhere to go
+    bool Think(const GameState& state, std::vector<Action>& actions);
+
+    const BotWeights& GetWeights() const { return weights; }
+
+  private:
+    BotWeights weights;
+    PlacementSearch search;
+    PlacementFeatures features;
+    std::vector<f32> scores;
+    // heights of the columns after each placement, column major:
+    // heights[column * placement count + placement]
+    std::vector<u8> heights;
+    // neighbour of the columns on the border
+    std::vector<u8> walls;
+};
+
+};
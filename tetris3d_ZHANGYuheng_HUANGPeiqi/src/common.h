@@ -1,17 +1,63 @@
 #pragma once
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 #include <array>
+#include <utility>
 #include <vector>
 
 using u8 = uint8_t;
 using i8 = int8_t;
 using u32 = uint32_t;
 using i32 = int32_t;
+using u64 = uint64_t;
 using f32 = float;
 using f64 = double;
 
+// Vector with inline storage for at most N elements. It is trivially
+// copyable when T is, so it never allocates and copies with a memcpy.
+template <typename T, u32 N> class InlineVector {
+  public:
+    void push_back(const T& value) {
+        assert(count < N);
+        items[count++] = value;
+    }
+
+    template <typename... Args> void emplace_back(Args&&... args) {
+        push_back(T(std::forward<Args>(args)...));
+    }
+
+    void clear() { count = 0; }
+
+    void resize(size_t size) {
+        assert(size <= N);
+        for (auto i = count; i < size; ++i) {
+            items[i] = T{};
+        }
+        count = static_cast<u32>(size);
+    }
+
+    T* data() { return items.data(); }
+    const T* data() const { return items.data(); }
+
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + count; }
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + count; }
+
+    T& operator[](size_t index) { return items[index]; }
+    const T& operator[](size_t index) const { return items[index]; }
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+  private:
+    std::array<T, N> items;
+    u32 count = 0;
+};
+
 struct Color {
     f32 r = 0.f;
     f32 g = 0.f;
@@ -25,14 +71,26 @@ struct ColorR8G8B8 {
     u8 b = 0;
 };
 
-inline u32 PackColor(const ColorR8G8B8& color) {
-    return (color.r << 16) | (color.g << 8) | color.b;
+inline Color ToColor(const ColorR8G8B8& color) {
+    Color result;
+    result.r = color.r / 255.f;
+    result.g = color.g / 255.f;
+    result.b = color.b / 255.f;
+    return result;
 }
 
-inline Color FromPackedColorToColor(u32 color_pack) {
-    Color color;
-    color.r = ((color_pack & 0xff0000) >> 16) / 255.f;
-    color.g = ((color_pack & 0xff00) >> 8) / 255.f;
-    color.b = (color_pack & 0xff) / 255.f;
-    return color;
-}
\ No newline at end of file
+// Colors of a game. Board cells hold an index into the palette and index 0
+// stands for an empty cell, so a palette has at most 255 colors.
+struct Palette {
+    // Add a color and return its index, or 0 when the palette is full
+    u8 Add(const ColorR8G8B8& color) {
+        if (size == colors.size()) {
+            return 0;
+        }
+        colors[size] = color;
+        return static_cast<u8>(size++);
+    }
+
+    std::array<ColorR8G8B8, 256> colors;
+    u32 size = 1;
+};
\ No newline at end of file
@@ -1,20 +1,42 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdio>
 #include <memory>
 
 #include "camera.h"
 #include "common.h"
+#include "glm/geometric.hpp"
+#include "glm/gtc/constants.hpp"
 #include "glm/mat4x4.hpp"
 #include "glm/vec3.hpp"
 #include "input.h"
 #include "logic.h"
 #include "renderer.h"
+#include "replay.h"
+#include "save.h"
 #include "settings.h"
 
 class Game {
   public:
+    ~Game() {
+        replay_writer.Close(game_state.tick);
+
+        if (Settings::save_path) {
+            if (IsFinished()) {
+                remove(Settings::save_path);
+            } else {
+                GameLogic::SaveGame(Settings::save_path, game_state);
+            }
+        }
+    }
+
     bool StartUp() {
+        // NOTE: a replay starts from the seed, so a resumed game is not
+        // recorded
+        auto resumed = Settings::save_path &&
+                       GameLogic::LoadGame(Settings::save_path, game_state);
 
         renderer = std::make_unique<AdvancedRenderer>();
         renderer->Initialize(game_state);
@@ -24,6 +46,13 @@ class Game {
             Settings::graphics_resolution_width /
             static_cast<f32>(Settings::graphics_resolution_height));
 
+        if (Settings::replay_path && !resumed) {
+            replay_writer.Open(
+                Settings::replay_path,
+                GameLogic::ReplayHeader::Create(
+                    game_state.seed, game_state.randomizer.generator));
+        }
+
         return true;
     }
 
@@ -32,12 +61,87 @@ class Game {
         renderer->SetFramebufferHeight(height);
     }
 
-    void Update(const InputState& input, f32 elapsed_seconds) {
+    // Handle the input of a frame then advance the rules by a number of
+    // fixed ticks
+    void Update(const InputState& input, u32 ticks) {
 
 
         camera_controller.Update(&camera, input);
-        GameLogic::processGameUpdate(game_state, elapsed_seconds, input,
-                          camera.GetForward());
+
+        auto view_direction = camera.GetForward();
+        if (view_direction != key_actions_view_direction) {
+            UpdateKeyActions(view_direction);
+        }
+        for (const auto& key_action : key_actions) {
+            if (input.IsKeyPressed(key_action.key) &&
+                GameLogic::Apply(game_state, key_action.action)) {
+                replay_writer.RecordAction(game_state.tick, key_action.action);
+            }
+        }
+        auto accelerate = input.IsKeyDown(Settings::key_block_accelerate);
+        replay_writer.RecordAccelerate(game_state.tick, accelerate);
+        for (u32 tick = 0; tick < ticks; ++tick) {
+            GameLogic::processGameUpdate(game_state, accelerate);
+        }
+
+        if (IsFinished()) {
+            replay_writer.Close(game_state.tick);
+        }
+    }
+
+    // Map the block keys, which are relative to the view, to the actions on
+    // the board axis the camera is facing
+    void UpdateKeyActions(const glm::vec3& view_direction) {
+        using GameLogic::Action;
+
+        auto view_dir_xz = view_direction;
+        view_dir_xz.y = 0.f;
+        view_dir_xz = glm::normalize(view_dir_xz);
+        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
+        auto facing_z = glm::abs(dot) < glm::cos(glm::pi<f32>() / 4.f);
+
+        auto from_top = view_direction.y < 0.f;
+        key_actions[0] = {Settings::key_block_horiz_rot_clock,
+                          from_top ? Action::RotateYClockwise
+                                   : Action::RotateYCounterClockwise};
+        key_actions[1] = {Settings::key_block_horiz_rot_counterclock,
+                          from_top ? Action::RotateYCounterClockwise
+                                   : Action::RotateYClockwise};
+
+        if (facing_z) {
+            auto away = view_direction.z < 0.f;
+            auto towards = view_direction.z > 0.f;
+            key_actions[2] = {Settings::key_block_vert_rot_away,
+                              away ? Action::RotateXClockwise
+                                   : Action::RotateXCounterClockwise};
+            key_actions[3] = {Settings::key_block_vert_rot_towards,
+                              towards ? Action::RotateXClockwise
+                                      : Action::RotateXCounterClockwise};
+            key_actions[4] = {Settings::key_block_move_away,
+                              away ? Action::MoveZNegative
+                                   : Action::MoveZPositive};
+            key_actions[5] = {Settings::key_block_move_towards,
+                              towards ? Action::MoveZNegative
+                                      : Action::MoveZPositive};
+        } else {
+            auto away = view_direction.x < 0.f;
+            auto towards = view_direction.x > 0.f;
+            key_actions[2] = {Settings::key_block_vert_rot_away,
+                              away ? Action::RotateZCounterClockwise
+                                   : Action::RotateZClockwise};
+            key_actions[3] = {Settings::key_block_vert_rot_towards,
+                              towards ? Action::RotateZCounterClockwise
+                                      : Action::RotateZClockwise};
+            key_actions[4] = {Settings::key_block_move_away,
+                              away ? Action::MoveXNegative
+                                   : Action::MoveXPositive};
+            key_actions[5] = {Settings::key_block_move_towards,
+                              towards ? Action::MoveXNegative
+                                      : Action::MoveXPositive};
+        }
+
+        key_actions[6] = {Settings::key_block_hard_drop, Action::HardDrop};
+        key_actions_view_direction = view_direction;
     }
 
     void CenterCamera(Camera& camera) {
@@ -57,8 +161,19 @@ class Game {
     void Draw() { renderer->Render(game_state, camera); }
 
   private:
-    GameLogic::GameState game_state;
+    // every start of the application plays a new game
+    GameLogic::GameState game_state{static_cast<u64>(
+        std::chrono::system_clock::now().time_since_epoch().count())};
     PerspectiveCamera camera;
     OrbitCameraController camera_controller;
+
+    struct KeyAction {
+        i32 key = 0;
+        GameLogic::Action action = GameLogic::Action::SoftDrop;
+    };
+    // actions of the block keys for the camera direction below
+    std::array<KeyAction, 7> key_actions;
+    glm::vec3 key_actions_view_direction = glm::vec3(0.f);
     std::unique_ptr<IRenderer> renderer;
+    GameLogic::ReplayWriter replay_writer;
 };
@@ -6,6 +6,24 @@
 
 #include "common.h"
 
+namespace Settings {
+
+const i32 key_playground_rotate_left = GLFW_KEY_LEFT;
+const i32 key_playground_rotate_right = GLFW_KEY_RIGHT;
+const i32 key_playground_rotate_up = GLFW_KEY_UP;
+const i32 key_playground_rotate_down = GLFW_KEY_DOWN;
+const i32 key_block_vert_rot_away = GLFW_KEY_W;
+const i32 key_block_vert_rot_towards = GLFW_KEY_S;
+const i32 key_block_horiz_rot_clock = GLFW_KEY_A;
+const i32 key_block_horiz_rot_counterclock = GLFW_KEY_D;
+const i32 key_block_move_away = GLFW_KEY_Q;
+const i32 key_block_move_towards = GLFW_KEY_E;
+const i32 key_block_accelerate = GLFW_KEY_SPACE;
+const i32 key_block_hard_drop = GLFW_KEY_ENTER;
+const i32 key_quit = GLFW_KEY_ESCAPE;
+
+};
+
 class InputState {
   public:
     InputState() {
@@ -11,65 +11,25 @@
 
 namespace GameLogic {
 
-Block Block::Create(BlockType type, const ColorR8G8B8& color,
-                    const Board3D& board) {
+template <typename Board>
+Block Block::Create(BlockType type, u8 color, const Board& board) {
     Block block;
     block.type = type;
     block.color = color;
     block.position = glm::ivec3(board.width / 2, board.height, board.depth / 2);
 
+    block.SetOrientation(0);
+
     switch (type) {
-    case BlockType::LShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(1, 0, 0);
-        block.cube_offsets.emplace_back(1, 1, 0);
-        block.position -= glm::ivec3(0, 2, 0);
-        break;
-    case BlockType::IShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(-2, 0, 0);
-        block.cube_offsets.emplace_back(1, 0, 0);
+    case BlockType::IShape:
         block.position -= glm::ivec3(0, 1, 0);
         break;
-    case BlockType::JShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(1, 0, 0);
-        block.cube_offsets.emplace_back(-1, 1, 0);
-        block.position -= glm::ivec3(0, 2, 0);
-        break;
-    case BlockType::OShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(0, 1, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(-1, 1, 0);
-        block.cube_offsets.emplace_back(0, 0, 1);
-        block.cube_offsets.emplace_back(0, 1, 1);
-        block.cube_offsets.emplace_back(-1, 0, 1);
-        block.cube_offsets.emplace_back(-1, 1, 1);
-        block.position -= glm::ivec3(0, 2, 0);
-        break;
-    case BlockType::SShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(0, 1, 0);
-        block.cube_offsets.emplace_back(1, 1, 0);
-        block.position -= glm::ivec3(0, 2, 0);
-        break;
-    case BlockType::TShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(-1, 0, 0);
-        block.cube_offsets.emplace_back(1, 0, 0);
-        block.cube_offsets.emplace_back(0, 1, 0);
-        block.position -= glm::ivec3(0, 2, 0);
-        break;
-    case BlockType::ZShape: 
-        block.cube_offsets.emplace_back(0, 0, 0);
-        block.cube_offsets.emplace_back(0, 1, 0);
-        block.cube_offsets.emplace_back(-1, 1, 0);
-        block.cube_offsets.emplace_back(1, 0, 0);
+    case BlockType::LShape:
+    case BlockType::JShape:
+    case BlockType::OShape:
+    case BlockType::SShape:
+    case BlockType::TShape:
+    case BlockType::ZShape:
         block.position -= glm::ivec3(0, 2, 0);
         break;
     case BlockType::Undefined:
@@ -77,6 +37,8 @@ Block Block::Create(BlockType type, const ColorR8G8B8& color,
         assert(false);
     }
 
+    // NOTE: the block stops at the first free height, which can be in a gap
+    // under the top of a column
     while (block.IsCollidingWithOtherBlocks(board)) {
         block.Translate(glm::ivec3(0, 1, 0));
     }
@@ -84,76 +46,94 @@ Block Block::Create(BlockType type, const ColorR8G8B8& color,
     return block;
 }
 
-Block Block::CreateRandom(const Board3D& board) {
-    u32 randomBlockTypeIndex = rand() % static_cast<u32>(BlockType::Undefined);
-    BlockType blockType = static_cast<BlockType>(randomBlockTypeIndex);
+BlockType BlockRandomizer::Next(Rng& rng) {
+    if (generator == Settings::BlockGenerator::Uniform) {
+        return static_cast<BlockType>(rng.Below(block_type_count));
+    }
 
-    ColorR8G8B8 randomColor{0, 0, 0};
-    while (!randomColor.r && !randomColor.b && !randomColor.g) {
-        randomColor = ColorR8G8B8{static_cast<u8>(rand() % 256),
-                            static_cast<u8>(rand() % 256),
-                            static_cast<u8>(rand() % 256)};
+    if (!bag_size) {
+        // Fisher-Yates shuffle of a new bag
+        for (u32 i = 0; i < block_type_count; ++i) {
+            bag[i] = static_cast<BlockType>(i);
+        }
+        for (u32 i = block_type_count - 1; i > 0; --i) {
+            std::swap(bag[i], bag[rng.Below(i + 1)]);
+        }
+        bag_size = block_type_count;
     }
+    return bag[--bag_size];
+}
+
+template <typename Board>
+Block Block::CreateRandom(const Board& board, const Palette& palette,
+                          BlockRandomizer& randomizer, Rng& rng) {
+    BlockType blockType = randomizer.Next(rng);
+
+    assert(palette.size > 1);
+    auto randomColor = static_cast<u8>(1 + rng.Below(palette.size - 1));
     return Block::Create(blockType, randomColor, board);
 }
 
+Palette CreateRandomPalette(Rng& rng) {
+    Palette palette;
+    while (palette.size < palette.colors.size()) {
+        ColorR8G8B8 randomColor{0, 0, 0};
+        while (!randomColor.r && !randomColor.b && !randomColor.g) {
+            auto bits = rng.Next();
+            randomColor = ColorR8G8B8{static_cast<u8>(bits),
+                                      static_cast<u8>(bits >> 8),
+                                      static_cast<u8>(bits >> 16)};
+        }
+        palette.Add(randomColor);
+    }
+    return palette;
+}
+
 void Block::Translate(const glm::ivec3& value) { position += value; }
 
+void Block::Rotate(RotationAxis axis, RotationDirection direction) {
+    const auto& table = GetOrientationTable(type);
+    SetOrientation(table.next[orientation][static_cast<u32>(axis)]
+                             [static_cast<u32>(direction)]);
+}
+
 void Block::RotateXClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.y = -offset.y;
-        std::swap(offset.y, offset.z);
-    }
+    Rotate(RotationAxis::X, RotationDirection::Clockwise);
 }
 
 void Block::RotateXCounterClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.z = -offset.z;
-        std::swap(offset.y, offset.z);
-    }
+    Rotate(RotationAxis::X, RotationDirection::CounterClockwise);
 }
 
 void Block::RotateYClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.z = -offset.z;
-        std::swap(offset.x, offset.z);
-    }
+    Rotate(RotationAxis::Y, RotationDirection::Clockwise);
 }
 
 void Block::RotateYCounterClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.x = -offset.x;
-        std::swap(offset.x, offset.z);
-    }
+    Rotate(RotationAxis::Y, RotationDirection::CounterClockwise);
 }
 
 void Block::RotateZClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.x = -offset.x;
-        std::swap(offset.x, offset.y);
-    }
+    Rotate(RotationAxis::Z, RotationDirection::Clockwise);
 }
 
 void Block::RotateZCounterClockwise() {
-    if (type == BlockType::OShape)
-        return;
-    for (auto& offset : cube_offsets) {
-        offset.y = -offset.y;
-        std::swap(offset.x, offset.y);
+    Rotate(RotationAxis::Z, RotationDirection::CounterClockwise);
+}
+
+void Block::SetOrientation(u32 value) {
+    const auto& table = GetOrientationTable(type);
+    assert(value < table.orientation_count);
+    orientation = static_cast<u8>(value);
+    cube_offsets.clear();
+    for (u32 i = 0; i < table.cube_count; ++i) {
+        const auto& cube = table.cubes[orientation][i];
+        cube_offsets.emplace_back(cube.x, cube.y, cube.z);
     }
 }
 
-bool Block::TryTranslate(const Board3D& board, const glm::ivec3& value) {
+template <typename Board>
+bool Block::TryTranslate(const Board& board, const glm::ivec3& value) {
     auto transformed_block = *this;
     transformed_block.Translate(value);
     if (transformed_block.IsValid(board)) {
@@ -163,7 +143,8 @@ bool Block::TryTranslate(const Board3D& board, const glm::ivec3& value) {
     return false;
 }
 
-bool Block::TryRotateXClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateXClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateXClockwise();
     if (transformed_block.IsValid(board)) {
@@ -173,7 +154,8 @@ bool Block::TryRotateXClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateXCounterClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateXCounterClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateXCounterClockwise();
     if (transformed_block.IsValid(board)) {
@@ -183,7 +165,8 @@ bool Block::TryRotateXCounterClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateYClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateYClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateYClockwise();
     if (transformed_block.IsValid(board)) {
@@ -193,7 +176,8 @@ bool Block::TryRotateYClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateYCounterClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateYCounterClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateYCounterClockwise();
     if (transformed_block.IsValid(board)) {
@@ -203,7 +187,8 @@ bool Block::TryRotateYCounterClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateZClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateZClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateZClockwise();
     if (transformed_block.IsValid(board)) {
@@ -213,7 +198,8 @@ bool Block::TryRotateZClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateZCounterClockwise(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateZCounterClockwise(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateZCounterClockwise();
     if (transformed_block.IsValid(board)) {
@@ -223,7 +209,8 @@ bool Block::TryRotateZCounterClockwise(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateXClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateXClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateXClockwise();
     if (transformed_block.IsValid(board) ||
@@ -234,7 +221,8 @@ bool Block::TryRotateXClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateXCounterClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateXCounterClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateXCounterClockwise();
     if (transformed_block.IsValid(board) ||
@@ -245,7 +233,8 @@ bool Block::TryRotateXCounterClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateYClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateYClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateYClockwise();
     if (transformed_block.IsValid(board) ||
@@ -256,7 +245,8 @@ bool Block::TryRotateYClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateYCounterClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateYCounterClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateYCounterClockwise();
     if (transformed_block.IsValid(board) ||
@@ -267,7 +257,8 @@ bool Block::TryRotateYCounterClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateZClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateZClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateZClockwise();
     if (transformed_block.IsValid(board) ||
@@ -278,7 +269,8 @@ bool Block::TryRotateZClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::TryRotateZCounterClockwiseWithFix(const Board3D& board) {
+template <typename Board>
+bool Block::TryRotateZCounterClockwiseWithFix(const Board& board) {
     auto transformed_block = *this;
     transformed_block.RotateZCounterClockwise();
     if (transformed_block.IsValid(board) ||
@@ -289,34 +281,97 @@ bool Block::TryRotateZCounterClockwiseWithFix(const Board3D& board) {
     return false;
 }
 
-bool Block::IsValid(const Board3D& board) const {
-    for (auto& offset : cube_offsets) {
-        auto world_pos = position + offset;
-        if (!board.Contains(world_pos) || !board.IsEmpty(world_pos)) {
+template <typename Board>
+bool Block::IsValid(const Board& board) const {
+    auto mask = board.GetPieceMask(type, orientation);
+    if (!mask) {
+        for (auto& offset : cube_offsets) {
+            auto world_pos = position + offset;
+            if (!board.Contains(world_pos) || !board.IsEmpty(world_pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the -x, -z and y bounds are checked on the corner, the guard bits of
+    // the layers take care of the +x and +z bounds
+    auto corner = position + glm::ivec3(mask->min.x, mask->min.y, mask->min.z);
+    if (corner.x < 0 || corner.z < 0 || corner.y < 0 ||
+        corner.x > static_cast<i32>(board.width) ||
+        corner.z > static_cast<i32>(board.depth) ||
+        corner.y + mask->layer_count > board.height) {
+        return false;
+    }
+
+    auto shift = board.LayerBit(corner);
+    for (u32 i = 0; i < mask->layer_count; ++i) {
+        if (mask->layers[i].ShiftedLeft(shift).Intersects(
+                board.layers[corner.y + i])) {
             return false;
         }
     }
     return true;
 }
 
-bool Block::IsCollidingWithOtherBlocks(const Board3D& board) const {
-    for (auto& offset : cube_offsets) {
-        auto world_pos = position + offset;
-        if (board.Contains(world_pos) && !board.IsEmpty(world_pos)) {
+template <typename Board>
+bool Block::IsCollidingWithOtherBlocks(const Board& board) const {
+    auto mask = board.GetPieceMask(type, orientation);
+    glm::ivec3 min_bounds, max_bounds;
+    GetWorldBounds(min_bounds, max_bounds);
+
+    // cubes out of the board do not collide, so the guard bits can only be
+    // used when the block is inside the footprint of the board
+    if (!mask || min_bounds.x < 0 || min_bounds.z < 0 ||
+        max_bounds.x >= static_cast<i32>(board.width) ||
+        max_bounds.z >= static_cast<i32>(board.depth)) {
+        for (auto& offset : cube_offsets) {
+            auto world_pos = position + offset;
+            if (board.Contains(world_pos) && !board.IsEmpty(world_pos)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto shift = board.LayerBit(min_bounds);
+    for (u32 i = 0; i < mask->layer_count; ++i) {
+        auto y = min_bounds.y + static_cast<i32>(i);
+        if (y >= 0 && y < static_cast<i32>(board.height) &&
+            mask->layers[i].ShiftedLeft(shift).Intersects(board.layers[y])) {
             return true;
         }
     }
     return false;
 }
 
-bool Block::TryFix(const Board3D& board, const Block& prev_block) {
+template <typename Board>
+bool Block::TryFix(const Board& board, const Block& prev_block) {
     assert(!IsValid(board));
 
+    auto translations = GetFixTranslations(prev_block);
+
+    // the same translations are tried one, two then three cells away
+    auto origin = position;
+    for (i32 distance = 1; distance <= block_max_fix_distance; ++distance) {
+        for (auto& translation : translations) {
+            position = origin + distance * translation;
+            if (IsValid(board)) {
+                return true;
+            }
+        }
+    }
+    position = origin;
+    return false;
+}
+
+InlineVector<glm::ivec3, 4>
+Block::GetFixTranslations(const Block& prev_block) const {
     glm::ivec3 min_bounds, max_bounds, prev_min_bounds, prev_max_bounds;
     this->GetWorldBounds(min_bounds, max_bounds);
     prev_block.GetWorldBounds(prev_min_bounds, prev_max_bounds);
 
-    std::vector<glm::ivec3> translations;
+    InlineVector<glm::ivec3, 4> translations;
 
 
     if (min_bounds.x < prev_min_bounds.x || max_bounds.x < prev_max_bounds.x) {
@@ -332,34 +387,29 @@ bool Block::TryFix(const Board3D& board, const Block& prev_block) {
     if (min_bounds.z > prev_min_bounds.z || max_bounds.z > prev_max_bounds.z) {
         translations.push_back(glm::ivec3(0, 0, -1));
     }
-
-    std::vector<Block> candidates(translations.size(), *this);
-
-    auto tries = 3;
-    while (tries--) {
-        for (size_t i = 0; i < translations.size(); ++i) {
-            candidates[i].Translate(translations[i]);
-            if (candidates[i].IsValid(board)) {
-                *this = candidates[i];
-                return true;
-            }
-        }
-    }
-    return false;
+    return translations;
 }
 
 void Block::GetWorldBounds(glm::ivec3& min, glm::ivec3& max) const {
-    min = glm::ivec3(INT_MAX, INT_MAX, INT_MAX);
-    max = glm::ivec3(INT_MIN, INT_MIN, INT_MIN);
-    for (auto& offset : cube_offsets) {
-        auto world_pos = position + offset;
-        min.x = std::min(min.x, world_pos.x);
-        min.y = std::min(min.y, world_pos.y);
-        min.z = std::min(min.z, world_pos.z);
-        max.x = std::max(max.x, world_pos.x);
-        max.y = std::max(max.y, world_pos.y);
-        max.z = std::max(max.z, world_pos.z);
+    if (cube_offsets.empty()) {
+        min = glm::ivec3(INT_MAX, INT_MAX, INT_MAX);
+        max = glm::ivec3(INT_MIN, INT_MIN, INT_MIN);
+        return;
     }
+    // NOTE: the cubes always are the ones of the orientation
+    const auto& table = GetOrientationTable(type);
+    const auto& min_offset = table.min[orientation];
+    const auto& max_offset = table.max[orientation];
+    min = position + glm::ivec3(min_offset.x, min_offset.y, min_offset.z);
+    max = position + glm::ivec3(max_offset.x, max_offset.y, max_offset.z);
+}
+
+u64 Block::GetHash() const {
+    return zobrist_keys.types[static_cast<u32>(type)] ^
+           zobrist_keys.orientations[orientation] ^
+           ZobristCoordinateKey(zobrist_keys.x, position.x) ^
+           ZobristCoordinateKey(zobrist_keys.y, position.y) ^
+           ZobristCoordinateKey(zobrist_keys.z, position.z);
 }
 
 int calculateGameScore(u32 linesCleared, int level) {
@@ -383,146 +433,83 @@ int calculateGameScore(u32 linesCleared, int level) {
     return pointsAwarded;
 }
 
-void processGameUpdate(GameState& state, f32 elapsedSeconds, const InputState& input,
-            const glm::vec3& viewDirection) {
-
-
-    if (input.IsKeyPressed(Settings::key_block_horiz_rot_clock)) {
-        if (viewDirection.y < 0.f) {
-            state.falling_block.TryRotateYClockwiseWithFix(state.board);
-        } else {
-            state.falling_block.TryRotateYCounterClockwiseWithFix(state.board);
-        }
-    }
-    if (input.IsKeyPressed(Settings::key_block_horiz_rot_counterclock)) {
-        if (viewDirection.y < 0.f) {
-            state.falling_block.TryRotateYCounterClockwiseWithFix(state.board);
-        } else {
-            state.falling_block.TryRotateYClockwiseWithFix(state.board);
-        }
+template <typename Board>
+bool Apply(BasicGameState<Board>& state, Action action) {
+    auto& block = state.falling_block;
+    const auto& board = state.board;
+    switch (action) {
+    case Action::MoveXPositive:
+        return block.TryTranslate(board, glm::ivec3(1, 0, 0));
+    case Action::MoveXNegative:
+        return block.TryTranslate(board, glm::ivec3(-1, 0, 0));
+    case Action::MoveZPositive:
+        return block.TryTranslate(board, glm::ivec3(0, 0, 1));
+    case Action::MoveZNegative:
+        return block.TryTranslate(board, glm::ivec3(0, 0, -1));
+    case Action::RotateXClockwise:
+        return block.TryRotateXClockwiseWithFix(board);
+    case Action::RotateXCounterClockwise:
+        return block.TryRotateXCounterClockwiseWithFix(board);
+    case Action::RotateYClockwise:
+        return block.TryRotateYClockwiseWithFix(board);
+    case Action::RotateYCounterClockwise:
+        return block.TryRotateYCounterClockwiseWithFix(board);
+    case Action::RotateZClockwise:
+        return block.TryRotateZClockwiseWithFix(board);
+    case Action::RotateZCounterClockwise:
+        return block.TryRotateZCounterClockwiseWithFix(board);
+    case Action::SoftDrop:
+    case Action::HardDrop:
+        break;
     }
 
-    if (input.IsKeyPressed(Settings::key_block_vert_rot_away)) {
-        auto view_dir_xz = viewDirection;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<f32>() / 4.f)) {
-            if (viewDirection.z < 0.f) {
-                state.falling_block.TryRotateXClockwiseWithFix(state.board);
-            } else {
-                state.falling_block.TryRotateXCounterClockwiseWithFix(
-                    state.board);
-            }
-        } else {
-            if (viewDirection.x < 0.f) {
-                state.falling_block.TryRotateZCounterClockwiseWithFix(
-                    state.board);
-            } else {
-                state.falling_block.TryRotateZClockwiseWithFix(state.board);
-            }
-        }
+    // drops only apply to a block in play
+    if (state.phase != GamePhase::NewBlockCreation &&
+        state.phase != GamePhase::BlockFalling) {
+        return false;
     }
-
-    if (input.IsKeyPressed(Settings::key_block_vert_rot_towards)) {
-        auto view_dir_xz = viewDirection;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<f32>() / 4.f)) {
-            if (viewDirection.z > 0.f) {
-                state.falling_block.TryRotateXClockwiseWithFix(state.board);
-            } else {
-                state.falling_block.TryRotateXCounterClockwiseWithFix(
-                    state.board);
-            }
-        } else {
-            if (viewDirection.x > 0.f) {
-                state.falling_block.TryRotateZCounterClockwiseWithFix(
-                    state.board);
-            } else {
-                state.falling_block.TryRotateZClockwiseWithFix(state.board);
-            }
-        }
+    if (action == Action::HardDrop) {
+        block.Translate(glm::ivec3(0, -ComputeDropDistance(state), 0));
     }
-
-    if (input.IsKeyPressed(Settings::key_block_move_away)) {
-        auto view_dir_xz = viewDirection;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<f32>() / 4.f)) {
-            if (viewDirection.z < 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, -1));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, 1));
-            }
-        } else {
-            if (viewDirection.x < 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(-1, 0, 0));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(1, 0, 0));
-            }
-        }
-    }
-
-    if (input.IsKeyPressed(Settings::key_block_move_towards)) {
-        auto view_dir_xz = viewDirection;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<f32>() / 4.f)) {
-            if (viewDirection.z > 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, -1));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, 1));
-            }
-        } else {
-            if (viewDirection.x > 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(-1, 0, 0));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(1, 0, 0));
-            }
-        }
+    // same as a gravity step, which restarts the fall timer
+    SingleStep(state);
+    if (state.phase == GamePhase::BlockFalling) {
+        state.ticks_to_next_block_fall = state.block_fall_step_ticks;
     }
+    return true;
+}
 
-    if (input.IsKeyDown(Settings::key_block_accelerate)) {
-        state.block_current_speed = state.block_max_fall_step_seconds;
-        state.seconds_to_next_block_fall = std::min(
-            state.seconds_to_next_block_fall, state.block_current_speed);
+template <typename Board>
+void processGameUpdate(BasicGameState<Board>& state, bool accelerate) {
+    if (accelerate) {
+        state.block_fall_step_ticks = Settings::block_max_fall_step_ticks;
+        state.ticks_to_next_block_fall = std::min(
+            state.ticks_to_next_block_fall, state.block_fall_step_ticks);
     } else {
-        state.block_current_speed = state.block_current_normal_speed;
+        state.block_fall_step_ticks =
+            gravity_table.fall_step_ticks[state.gravity_level];
     }
 
-    state.seconds_to_next_block_fall -= elapsedSeconds;
-    state.seconds_from_last_speed_inc -= elapsedSeconds;
-
-
-    if (state.seconds_to_next_block_fall < 0.f) {
+    // NOTE: the counter stays at 0 while no block is falling, so the phases
+    // between two blocks advance on every tick
+    if (state.ticks_to_next_block_fall > 0) {
+        --state.ticks_to_next_block_fall;
+    }
+    if (state.ticks_to_next_block_fall == 0) {
         SingleStep(state);
 
-        if (state.phase == GameState::Phase::BlockFalling) {
-            state.seconds_to_next_block_fall = state.block_current_speed;
+        if (state.phase == GamePhase::BlockFalling) {
+            state.ticks_to_next_block_fall = state.block_fall_step_ticks;
         }
     }
 
-
-    if (state.seconds_from_last_speed_inc < 0.f) {
-        state.block_current_normal_speed += (state.block_speed_inc_multiplier *
-                                             state.block_current_normal_speed);
-        state.seconds_from_last_speed_inc =
-            state.block_speed_inc_period_seconds;
+    if (--state.ticks_to_next_speed_inc == 0) {
+        state.gravity_level =
+            std::min(state.gravity_level + 1, gravity_table_size - 1);
+        state.ticks_to_next_speed_inc = Settings::block_speed_inc_period_ticks;
     }
 
-    state.total_time += elapsedSeconds;
+    ++state.tick;
 
     u32 layersErased = state.board.EraseFilledLayers();
     if (layersErased > 0) {
@@ -531,53 +518,65 @@ void processGameUpdate(GameState& state, f32 elapsedSeconds, const InputState& i
     }
 }
 
+template <typename Board> u32 LandFallingBlock(BasicGameState<Board>& state) {
+    // same steps as processGameUpdate, which erases right after the merge
+    SingleStep(state);
+    auto erased = state.board.EraseFilledLayers();
+    state.score += calculateGameScore(erased, state.level);
+    SingleStep(state);
+    return erased;
+}
 
-void SingleStep(GameState& state) {
-    if (state.phase == GameState::Phase::Lost) {
+template <typename Board>
+void SingleStep(BasicGameState<Board>& state) {
+    if (state.phase == GamePhase::Lost) {
         return;
     }
 
-    if (state.phase == GameState::Phase::Uninitialized) {
-        state.falling_block = Block::CreateRandom(state.board);
-        state.phase = GameState::Phase::NewBlockCreation;
+    if (state.phase == GamePhase::Uninitialized) {
+        state.falling_block = Block::CreateRandom(state.board, state.palette,
+                                                  state.randomizer, state.rng);
+        state.phase = GamePhase::NewBlockCreation;
         return;
     }
 
-    if (state.phase == GameState::Phase::BlockMerge) {
+    if (state.phase == GamePhase::BlockMerge) {
         if (state.board.EraseFilledLayers()) {
-            state.phase = GameState::Phase::LayersErase;
+            state.phase = GamePhase::LayersErase;
             return;
         }
     }
 
-    if (state.phase == GameState::Phase::BlockMerge ||
-        state.phase == GameState::Phase::LayersErase) {
-        state.falling_block = Block::CreateRandom(state.board);
-        state.phase = GameState::Phase::NewBlockCreation;
+    if (state.phase == GamePhase::BlockMerge ||
+        state.phase == GamePhase::LayersErase) {
+        state.falling_block = Block::CreateRandom(state.board, state.palette,
+                                                  state.randomizer, state.rng);
+        state.phase = GamePhase::NewBlockCreation;
         return;
     }
 
     if (!CanFallingBlockFall(state)) {
         if (!state.falling_block.IsValid(state.board)) {
-            state.phase = GameState::Phase::Lost;
+            state.phase = GamePhase::Lost;
             return;
         }
         MergeFallingBlock(state);
-        state.phase = GameState::Phase::BlockMerge;
+        state.phase = GamePhase::BlockMerge;
         return;
     } else {
         state.falling_block.Translate(glm::ivec3(0, -1, 0));
-        state.phase = GameState::Phase::BlockFalling;
+        state.phase = GamePhase::BlockFalling;
         return;
     }
 }
 
-bool CanFallingBlockFall(const GameState& state) {
+template <typename Board>
+bool CanFallingBlockFall(const BasicGameState<Board>& state) {
     for (auto& cube_offset : state.falling_block.cube_offsets) {
         auto absolute_pos = state.falling_block.position + cube_offset;
         auto final_pos = absolute_pos - glm::ivec3(0, 1, 0);
-        // TODO(panmar): For now, do not consider starting position
-        if (final_pos.y >= 50)
+        // NOTE: cubes above the board cannot collide
+        if (final_pos.y >= static_cast<i32>(state.board.height))
             continue;
         if (final_pos.y < 0 || !state.board.IsEmpty(final_pos)) {
             return false;
@@ -592,11 +591,84 @@ bool CanFallingBlockFall(const GameState& state) {
     return true;
 }
 
-void MergeFallingBlock(GameState& state) {
+template <typename Board>
+i32 ComputeDropDistance(const BasicGameState<Board>& state) {
+    return ComputeDropDistance(state.falling_block, state.board);
+}
+
+template <typename Board>
+i32 ComputeDropDistance(const Block& block, const Board& board) {
+    // the block lands on the highest column under its lowest cubes, unless
+    // it was moved under an overhang
+    auto distance = INT_MAX;
+    for (auto& offset : block.cube_offsets) {
+        auto world_pos = block.position + offset;
+        if (world_pos.x < 0 || world_pos.z < 0 ||
+            world_pos.x >= static_cast<i32>(board.width) ||
+            world_pos.z >= static_cast<i32>(board.depth)) {
+            distance = INT_MAX;
+            break;
+        }
+        auto column_height = static_cast<i32>(
+            board.GetColumnHeight(world_pos.x, world_pos.z));
+        if (world_pos.y < column_height) {
+            distance = INT_MAX;
+            break;
+        }
+        distance = std::min(distance, world_pos.y - column_height);
+    }
+    if (distance != INT_MAX) {
+        return distance;
+    }
+
+    auto dropped_block = block;
+    distance = 0;
+    while (dropped_block.TryTranslate(board, glm::ivec3(0, -1, 0))) {
+        ++distance;
+    }
+    return distance;
+}
+
+template <typename Board>
+void MergeFallingBlock(BasicGameState<Board>& state) {
     for (auto& cube_offset : state.falling_block.cube_offsets) {
         auto absolute_pos = state.falling_block.position + cube_offset;
-        state.board.Fill(absolute_pos, PackColor(state.falling_block.color));
+        state.board.Fill(absolute_pos, state.falling_block.color);
     }
 }
 
+// NOTE: the board dependent functions are defined here and instantiated for
+// the supported boards only
+#define INSTANTIATE_GAME_LOGIC(Board)                                          \
+    template Block Block::Create(BlockType, u8, const Board&);                 \
+    template Block Block::CreateRandom(const Board&, const Palette&,           \
+                                       BlockRandomizer&, Rng&);                \
+    template bool Block::TryTranslate(const Board&, const glm::ivec3&);        \
+    template bool Block::TryRotateXClockwise(const Board&);                    \
+    template bool Block::TryRotateXCounterClockwise(const Board&);             \
+    template bool Block::TryRotateYClockwise(const Board&);                    \
+    template bool Block::TryRotateYCounterClockwise(const Board&);             \
+    template bool Block::TryRotateZClockwise(const Board&);                    \
+    template bool Block::TryRotateZCounterClockwise(const Board&);             \
+    template bool Block::TryRotateXClockwiseWithFix(const Board&);             \
+    template bool Block::TryRotateXCounterClockwiseWithFix(const Board&);      \
+    template bool Block::TryRotateYClockwiseWithFix(const Board&);             \
+    template bool Block::TryRotateYCounterClockwiseWithFix(const Board&);      \
+    template bool Block::TryRotateZClockwiseWithFix(const Board&);             \
+    template bool Block::TryRotateZCounterClockwiseWithFix(const Board&);      \
+    template bool Block::IsValid(const Board&) const;                          \
+    template bool Block::IsCollidingWithOtherBlocks(const Board&) const;       \
+    template bool Block::TryFix(const Board&, const Block&);                   \
+    template bool Apply(BasicGameState<Board>&, Action);                       \
+    template void processGameUpdate(BasicGameState<Board>&, bool);             \
+    template void SingleStep(BasicGameState<Board>&);                          \
+    template u32 LandFallingBlock(BasicGameState<Board>&);                     \
+    template bool CanFallingBlockFall(const BasicGameState<Board>&);           \
+    template void MergeFallingBlock(BasicGameState<Board>&);                   \
+    template i32 ComputeDropDistance(const BasicGameState<Board>&);            \
+    template i32 ComputeDropDistance(const Block&, const Board&);
+
+INSTANTIATE_GAME_LOGIC(Board3D)
+INSTANTIATE_GAME_LOGIC(DynamicBoard3D)
+
 }
@@ -1,39 +1,48 @@
 #pragma once
 
 #include <algorithm>
-#include <random>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <type_traits>
 
+#include "board.h"
 #include "common.h"
 #include "glm/vec3.hpp"
-#include "input.h"
+#include "orientation.h"
+#include "random.h"
 #include "settings.h"
 
 namespace GameLogic {
 
-enum class BlockType {  // block types
-    IShape,
-    LShape,
-    JShape,
-    OShape,
-    SShape,
-    TShape,
-    ZShape,
+// Picks the types of the successive blocks
+struct BlockRandomizer {
+    BlockType Next(Rng& rng);
 
-    Undefined //for initialization
+    Settings::BlockGenerator generator = Settings::block_generator;
+    // types left in the current bag, dealt from the back
+    BlockType bag[block_type_count] = {};
+    u32 bag_size = 0;
 };
 
-class Board3D;
+// TryFix moves a rotated block at most this many cells
+const i32 block_max_fix_distance = 3;
 
+// Functions taking a board are templates instantiated for Board3D and
+// DynamicBoard3D in logic.cc
 class Block {
   public:
     // Create a block
-    static Block Create(BlockType type, const ColorR8G8B8& color,
-                        const Board3D& board);
-    static Block CreateRandom(const Board3D& board);
+    template <typename Board>
+    static Block Create(BlockType type, u8 color, const Board& board);
+    template <typename Board>
+    static Block CreateRandom(const Board& board, const Palette& palette,
+                              BlockRandomizer& randomizer, Rng& rng);
 
     // move block
     void Translate(const glm::ivec3& value);
     // rotate block
+    void Rotate(RotationAxis axis, RotationDirection direction);
     void RotateXClockwise();
     void RotateXCounterClockwise();
     void RotateYClockwise();
@@ -41,188 +50,209 @@ class Block {
     void RotateZClockwise();
     void RotateZCounterClockwise();
 
-    bool TryTranslate(const Board3D& board, const glm::ivec3& value);
-    bool TryRotateXClockwise(const Board3D& board);
-    bool TryRotateXCounterClockwise(const Board3D& board);
-    bool TryRotateYClockwise(const Board3D& board);
-    bool TryRotateYCounterClockwise(const Board3D& board);
-    bool TryRotateZClockwise(const Board3D& board);
-    bool TryRotateZCounterClockwise(const Board3D& board);
+    template <typename Board>
+    bool TryTranslate(const Board& board, const glm::ivec3& value);
+    template <typename Board> bool TryRotateXClockwise(const Board& board);
+    template <typename Board>
+    bool TryRotateXCounterClockwise(const Board& board);
+    template <typename Board> bool TryRotateYClockwise(const Board& board);
+    template <typename Board>
+    bool TryRotateYCounterClockwise(const Board& board);
+    template <typename Board> bool TryRotateZClockwise(const Board& board);
+    template <typename Board>
+    bool TryRotateZCounterClockwise(const Board& board);
 
     // rotate block with fix the invalid position
-    bool TryRotateXClockwiseWithFix(const Board3D& board);
-    bool TryRotateXCounterClockwiseWithFix(const Board3D& board);
-    bool TryRotateYClockwiseWithFix(const Board3D& board);
-    bool TryRotateYCounterClockwiseWithFix(const Board3D& board);
-    bool TryRotateZClockwiseWithFix(const Board3D& board);
-    bool TryRotateZCounterClockwiseWithFix(const Board3D& board);
-
-    bool IsValid(const Board3D& board) const;
-    bool IsCollidingWithOtherBlocks(const Board3D& board) const;
-    bool TryFix(const Board3D& board, const Block& prev_block);
+    template <typename Board>
+    bool TryRotateXClockwiseWithFix(const Board& board);
+    template <typename Board>
+    bool TryRotateXCounterClockwiseWithFix(const Board& board);
+    template <typename Board>
+    bool TryRotateYClockwiseWithFix(const Board& board);
+    template <typename Board>
+    bool TryRotateYCounterClockwiseWithFix(const Board& board);
+    template <typename Board>
+    bool TryRotateZClockwiseWithFix(const Board& board);
+    template <typename Board>
+    bool TryRotateZCounterClockwiseWithFix(const Board& board);
+
+    template <typename Board> bool IsValid(const Board& board) const;
+    template <typename Board>
+    bool IsCollidingWithOtherBlocks(const Board& board) const;
+    template <typename Board>
+    bool TryFix(const Board& board, const Block& prev_block);
+    // Directions TryFix moves the block in, back toward the bounds of the
+    // block before the rotation
+    InlineVector<glm::ivec3, 4>
+    GetFixTranslations(const Block& prev_block) const;
 
     void GetWorldBounds(glm::ivec3& min, glm::ivec3& max) const;
 
+    // Zobrist hash of the type, orientation and position, see ZobristKeys
+    u64 GetHash() const;
+
+    // Set the orientation and its cubes from the orientation table
+    void SetOrientation(u32 value);
+
     BlockType type = BlockType::Undefined;
+    // index in the orientation table of the block type
+    u8 orientation = 0;
 
-    glm::ivec3 position;
+    glm::ivec3 position = glm::ivec3(0);
 
-    std::vector<glm::ivec3> cube_offsets;
-    ColorR8G8B8 color;
+    InlineVector<glm::ivec3, block_max_cubes> cube_offsets;
+    // index in the palette of the game
+    u8 color = 0;
 };
 
-class Board3D {
-  public:
-    // Create a board
-    Board3D(u32 _width = Settings::map_width, u32 _depth = Settings::map_depth,
-            u32 _height = Settings::map_height)
-        : width(_width), depth(_depth), height(_height),
-          cells(width * depth * height, 0) {}
-    
-    // Fill the board with block
-    void Fill(const glm::ivec3& position, u32 value) {
-        auto index = PositionToIndex(position);
-        cells[index] = value;
-    }
+static_assert(std::is_trivially_copyable<Block>::value,
+              "Block is copied on every move and must not allocate");
 
-    // Check if the position is empty
-    bool IsEmpty(const glm::ivec3& position) const {
-        auto index = PositionToIndex(position);
-        return !cells[index];
-    }
+// Palette of random colors used by the blocks of a game
+Palette CreateRandomPalette(Rng& rng);
 
-    // Check if the position is filled
-    bool Contains(const glm::ivec3& position) const {
-        if (position.x < 0 || position.y < 0 || position.z < 0 ||
-            position.x >= static_cast<i32>(width) ||
-            position.y >= static_cast<i32>(height) ||
-            position.z >= static_cast<i32>(depth)) {
-            return false;
-        }
-        return true;
-    }
+enum class GamePhase {
+    Uninitialized,
+    NewBlockCreation,
+    BlockFalling,
+    BlockMerge,
+    LayersErase,
+    Lost
+};
 
-    size_t PositionToIndex(const glm::vec3& world_pos) const {
-        return (world_pos.x * width + world_pos.z) +
-               (world_pos.y * width * depth);
-    }
+// Fall step of the block after each speed increment, in ticks. The curve is
+// computed in 16.16 fixed point at compile time, so it is the same on every
+// machine. The speed stops changing at the end of the table.
+const u32 gravity_table_size = 256;
 
-    // when layer is filled, erase the layer and return the number of filled layers
-    u32 EraseFilledLayers() {
-        auto filled_layers = 0U;
-        for (size_t layer = 0; layer < height;) {
-            if (IsLayerFilled(layer)) {
-                EraseLayer(layer);
-                ++filled_layers;
-            } else {
-                ++layer;
-            }
-        }
-        return filled_layers;
-    }
+struct GravityTable {
+    u32 fall_step_ticks[gravity_table_size] = {};
+};
 
-    void EraseLayer(u32 layer) {
-        for (size_t i = 0; i < width; ++i) {
-            for (size_t j = 0; j < depth; ++j) {
-                auto index = (i * width + j) + (layer * width * depth);
-                cells[index] = 0;
-            }
-        }
-
-        {
-            for (size_t layer1 = layer; layer1 < height - 1; ++layer1) {
-                auto layer2 = layer1 + 1;
-                for (size_t i = 0; i < width; ++i) {
-                    for (size_t j = 0; j < depth; ++j) {
-                        auto index1 =
-                            (i * width + j) + (layer1 * width * depth);
-                        auto index2 =
-                            (i * width + j) + (layer2 * width * depth);
-                        cells[index1] = cells[index2];
-                        cells[index2] = 0;
-                    }
-                }
-            }
-        }
-    }
+namespace detail {
 
-    bool IsLayerFilled(u32 layer) const {
-        for (size_t i = 0; i < width; ++i) {
-            for (size_t j = 0; j < depth; ++j) {
-                auto index = (i * width + j) + (layer * width * depth);
-                if (!cells[index]) {
-                    return false;
-                }
-            }
-        }
-        return true;
+constexpr GravityTable MakeGravityTable() {
+    GravityTable table;
+    auto step = static_cast<u64>(Settings::block_init_fall_step_ticks) << 16;
+    for (u32 i = 0; i < gravity_table_size; ++i) {
+        auto ticks = static_cast<u32>((step + (1 << 15)) >> 16);
+        table.fall_step_ticks[i] = ticks ? ticks : 1;
+        step += step * Settings::block_speed_inc_percent / 100;
     }
+    return table;
+}
 
-    const u32 width = 0;
-    const u32 depth = 0;
-    const u32 height = 0;
+} // namespace detail
 
-    std::vector<u32> cells;
-};
+inline constexpr GravityTable gravity_table = detail::MakeGravityTable();
+
+template <typename Board> struct BasicGameState {
+    // The same seed and generator always give the same game
+    explicit BasicGameState(
+        u64 seed = 0,
+        Settings::BlockGenerator block_generator = Settings::block_generator)
+        : seed(seed), rng(seed), palette(CreateRandomPalette(rng)) {
+        randomizer.generator = block_generator;
+    }
 
-struct GameState {
-    GameState(
-        f32 block_init_fall_step_seconds =
-            Settings::block_init_fall_step_seconds,
-        f32 block_max_fall_step_seconds = Settings::block_max_fall_step_seconds,
-        f32 block_speed_inc_multiplier = Settings::block_speed_inc_multiplier,
-        f32 block_speed_inc_period_seconds =
-            Settings::block_speed_inc_period_seconds)
-        : block_current_speed(block_init_fall_step_seconds),
-          block_current_normal_speed(block_init_fall_step_seconds),
-          block_max_fall_step_seconds(block_max_fall_step_seconds),
-          block_speed_inc_multiplier(block_speed_inc_multiplier),
-          block_speed_inc_period_seconds(block_speed_inc_period_seconds),
-          seconds_from_last_speed_inc(block_speed_inc_period_seconds),
-          seconds_to_next_block_fall(block_init_fall_step_seconds) {}
-
-    Board3D board;
+    Board board;
     Block falling_block;
 
     int score = 0; // current score
     int level = 0; // current level
 
-    enum class Phase {
-        Uninitialized,
-        NewBlockCreation,
-        BlockFalling,
-        BlockMerge,
-        LayersErase,
-        Lost
-    };
+    using Phase = GamePhase;
 
     Phase phase = Phase::Uninitialized;
 
     bool paused = false;
 
-    f32 block_current_speed = 0.f;
-    f32 block_current_normal_speed = 0.f;
-    const f32 block_max_fall_step_seconds = 0.f;
-    const f32 block_speed_inc_multiplier = 0.f;
-    const f32 block_speed_inc_period_seconds = 0.f;
+    u64 seed = 0;
+    Rng rng;
+    BlockRandomizer randomizer;
+
+    // ticks played since the start of the game
+    u64 tick = 0;
+    // speed increments so far, index in the gravity table
+    u32 gravity_level = 0;
+    // fall step of the last tick, shorter while accelerating
+    u32 block_fall_step_ticks = Settings::block_init_fall_step_ticks;
+    u32 ticks_to_next_block_fall = Settings::block_init_fall_step_ticks;
+    u32 ticks_to_next_speed_inc = Settings::block_speed_inc_period_ticks;
+
+    Palette palette;
+};
+
+// Commands of the player, in board coordinates. The frontend maps its
+// view-relative keys to actions, bots and replays feed them directly.
+enum class Action : u8 {
+    MoveXPositive,
+    MoveXNegative,
+    MoveZPositive,
+    MoveZNegative,
+    RotateXClockwise,
+    RotateXCounterClockwise,
+    RotateYClockwise,
+    RotateYCounterClockwise,
+    RotateZClockwise,
+    RotateZCounterClockwise,
+    SoftDrop, // fall one cell now, or land
+    HardDrop  // fall down to the landing position and land
+};
+
+const u32 action_count = static_cast<u32>(Action::HardDrop) + 1;
 
-    f32 total_time = 0.f;
-    f32 seconds_from_last_speed_inc = 0.f;
-    f32 seconds_to_next_block_fall = 0.f;
+// Game on the board of the settings
+using GameState = BasicGameState<Board3D>;
+// Game on a board with custom dimensions
+using DynamicGameState = BasicGameState<DynamicBoard3D>;
+
+static_assert(std::is_trivially_copyable<GameState>::value,
+              "a game on a fixed board is saved and restored with memcpy");
+
+// Bytes of a game, for search, rollback and replay seeking
+struct GameSnapshot {
+    alignas(GameState) u8 bytes[sizeof(GameState)];
 };
 
+inline void SaveSnapshot(const GameState& state, GameSnapshot& snapshot) {
+    memcpy(snapshot.bytes, &state, sizeof(GameState));
+}
+
+inline void RestoreSnapshot(GameState& state, const GameSnapshot& snapshot) {
+    memcpy(&state, snapshot.bytes, sizeof(GameState));
+}
+
 int calculateGameScore(u32 linesCleared, int level);
 
-void processGameUpdate(GameState& state, f32 elapsedSeconds, const InputState& input,
-            const glm::vec3& viewDirection);
+// Apply an action to the falling block, returns whether it had an effect
+template <typename Board>
+bool Apply(BasicGameState<Board>& state, Action action);
 
+// Advance the game by one logic tick, accelerate makes the block fall at
+// full speed
+template <typename Board>
+void processGameUpdate(BasicGameState<Board>& state, bool accelerate);
 
-void SingleStep(GameState& state);
+template <typename Board> void SingleStep(BasicGameState<Board>& state);
 
-bool IsFallingBlockOutOfBounds(const GameState& state);
+// Land the falling block where it is as the game does without waiting for
+// the ticks: merge it, erase and score the layers it fills, and deal the
+// next block. Returns the erased layers.
+template <typename Board> u32 LandFallingBlock(BasicGameState<Board>& state);
 
-bool CanFallingBlockFall(const GameState& state);
+template <typename Board>
+bool IsFallingBlockOutOfBounds(const BasicGameState<Board>& state);
 
-void MergeFallingBlock(GameState& state);
+template <typename Board>
+bool CanFallingBlockFall(const BasicGameState<Board>& state);
 
-};
+template <typename Board> void MergeFallingBlock(BasicGameState<Board>& state);
+
+// Number of cells the falling block can drop before landing
+template <typename Board>
+i32 ComputeDropDistance(const BasicGameState<Board>& state);
+template <typename Board>
+i32 ComputeDropDistance(const Block& block, const Board& board);
+
+};
\ No newline at end of file
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "common.h"
+
+namespace GameLogic {
+
+enum class BlockType {  // block types
+    IShape,
+    LShape,
+    JShape,
+    OShape,
+    SShape,
+    TShape,
+    ZShape,
+
+    Undefined //for initialization
+};
+
+const u32 block_type_count = static_cast<u32>(BlockType::Undefined);
+
+// OShape is the largest block
+const u32 block_max_cubes = 8;
+// number of rotations of a cube
+const u32 block_max_orientations = 24;
+
+enum class RotationAxis { X, Y, Z };
+enum class RotationDirection { Clockwise, CounterClockwise };
+
+// Cube offset usable in constant expressions
+struct CubeOffset {
+    i8 x = 0;
+    i8 y = 0;
+    i8 z = 0;
+};
+
+// All the distinct orientations of one block type. Orientation 0 is the
+// spawn orientation and next gives the orientation reached by a rotation:
+// next[orientation][axis][direction].
+struct OrientationTable {
+    u32 cube_count = 0;
+    u32 orientation_count = 0;
+    CubeOffset cubes[block_max_orientations][block_max_cubes] = {};
+    u8 next[block_max_orientations][3][2] = {};
+    // bounds of the cubes of every orientation
+    CubeOffset min[block_max_orientations] = {};
+    CubeOffset max[block_max_orientations] = {};
+    // lowest orientation with the same cubes up to a translation, a bar
+    // turned end over end only moves along its axis
+    u8 shape[block_max_orientations] = {};
+};
+
+namespace detail {
+
+// Same rotations as the original Block::Rotate* functions
+constexpr CubeOffset Rotate(CubeOffset offset, RotationAxis axis,
+                            RotationDirection direction) {
+    auto clockwise = direction == RotationDirection::Clockwise;
+    switch (axis) {
+    case RotationAxis::X:
+        return clockwise ? CubeOffset{offset.x, offset.z, i8(-offset.y)}
+                         : CubeOffset{offset.x, i8(-offset.z), offset.y};
+    case RotationAxis::Y:
+        return clockwise ? CubeOffset{i8(-offset.z), offset.y, offset.x}
+                         : CubeOffset{offset.z, offset.y, i8(-offset.x)};
+    case RotationAxis::Z:
+    default:
+        return clockwise ? CubeOffset{offset.y, i8(-offset.x), offset.z}
+                         : CubeOffset{i8(-offset.y), offset.x, offset.z};
+    }
+}
+
+constexpr bool IsLess(CubeOffset a, CubeOffset b) {
+    if (a.x != b.x)
+        return a.x < b.x;
+    if (a.y != b.y)
+        return a.y < b.y;
+    return a.z < b.z;
+}
+
+// Insertion sort, so that equal cube sets compare equal element by element
+constexpr void SortCubes(CubeOffset* cubes, u32 count) {
+    for (u32 i = 1; i < count; ++i) {
+        auto cube = cubes[i];
+        auto j = i;
+        for (; j > 0 && IsLess(cube, cubes[j - 1]); --j) {
+            cubes[j] = cubes[j - 1];
+        }
+        cubes[j] = cube;
+    }
+}
+
+constexpr bool AreSameCubes(const CubeOffset* a, const CubeOffset* b,
+                            u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE: a translation keeps the sorted order, so the cubes are compared in
+// place against the offset of the first ones
+constexpr bool AreTranslatedCubes(const CubeOffset* a, const CubeOffset* b,
+                                  u32 count) {
+    for (u32 i = 1; i < count; ++i) {
+        if (a[i].x - a[0].x != b[i].x - b[0].x ||
+            a[i].y - a[0].y != b[i].y - b[0].y ||
+            a[i].z - a[0].z != b[i].z - b[0].z) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bounds and shapes of the orientations once they are all known
+constexpr void FinishTable(OrientationTable& table) {
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        const auto* cubes = table.cubes[orientation];
+        auto& min = table.min[orientation];
+        auto& max = table.max[orientation];
+        min = max = cubes[0];
+        for (u32 i = 1; i < table.cube_count; ++i) {
+            min.x = cubes[i].x < min.x ? cubes[i].x : min.x;
+            min.y = cubes[i].y < min.y ? cubes[i].y : min.y;
+            min.z = cubes[i].z < min.z ? cubes[i].z : min.z;
+            max.x = cubes[i].x > max.x ? cubes[i].x : max.x;
+            max.y = cubes[i].y > max.y ? cubes[i].y : max.y;
+            max.z = cubes[i].z > max.z ? cubes[i].z : max.z;
+        }
+
+        auto shape = 0U;
+        while (!AreTranslatedCubes(table.cubes[orientation],
+                                   table.cubes[shape], table.cube_count)) {
+            ++shape;
+        }
+        table.shape[orientation] = static_cast<u8>(shape);
+    }
+}
+
+// Spawn orientation of every block type
+constexpr u32 SpawnCubes(BlockType type, CubeOffset* cubes) {
+    switch (type) {
+    case BlockType::LShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {-1, 0, 0};
+        cubes[2] = {1, 0, 0};
+        cubes[3] = {1, 1, 0};
+        return 4;
+    case BlockType::IShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {-1, 0, 0};
+        cubes[2] = {-2, 0, 0};
+        cubes[3] = {1, 0, 0};
+        return 4;
+    case BlockType::JShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {-1, 0, 0};
+        cubes[2] = {1, 0, 0};
+        cubes[3] = {-1, 1, 0};
+        return 4;
+    case BlockType::OShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {0, 1, 0};
+        cubes[2] = {-1, 0, 0};
+        cubes[3] = {-1, 1, 0};
+        cubes[4] = {0, 0, 1};
+        cubes[5] = {0, 1, 1};
+        cubes[6] = {-1, 0, 1};
+        cubes[7] = {-1, 1, 1};
+        return 8;
+    case BlockType::SShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {-1, 0, 0};
+        cubes[2] = {0, 1, 0};
+        cubes[3] = {1, 1, 0};
+        return 4;
+    case BlockType::TShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {-1, 0, 0};
+        cubes[2] = {1, 0, 0};
+        cubes[3] = {0, 1, 0};
+        return 4;
+    case BlockType::ZShape:
+        cubes[0] = {0, 0, 0};
+        cubes[1] = {0, 1, 0};
+        cubes[2] = {-1, 1, 0};
+        cubes[3] = {1, 0, 0};
+        return 4;
+    case BlockType::Undefined:
+    default:
+        return 0;
+    }
+}
+
+// Walk the rotation graph from the spawn orientation. Rotations which give
+// back an already known cube set reuse its index, so symmetric blocks get
+// fewer than 24 orientations.
+constexpr OrientationTable MakeOrientationTable(BlockType type) {
+    OrientationTable table;
+    table.cube_count = SpawnCubes(type, table.cubes[0]);
+    SortCubes(table.cubes[0], table.cube_count);
+    table.orientation_count = 1;
+
+    // NOTE: OShape does not rotate
+    if (type == BlockType::OShape) {
+        FinishTable(table);
+        return table;
+    }
+
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        for (u32 axis = 0; axis < 3; ++axis) {
+            for (u32 direction = 0; direction < 2; ++direction) {
+                CubeOffset rotated[block_max_cubes] = {};
+                for (u32 i = 0; i < table.cube_count; ++i) {
+                    rotated[i] =
+                        Rotate(table.cubes[orientation][i],
+                               static_cast<RotationAxis>(axis),
+                               static_cast<RotationDirection>(direction));
+                }
+                SortCubes(rotated, table.cube_count);
+
+                auto next = 0U;
+                while (next < table.orientation_count &&
+                       !AreSameCubes(rotated, table.cubes[next],
+                                     table.cube_count)) {
+                    ++next;
+                }
+                if (next == table.orientation_count) {
+                    for (u32 i = 0; i < table.cube_count; ++i) {
+                        table.cubes[next][i] = rotated[i];
+                    }
+                    ++table.orientation_count;
+                }
+                table.next[orientation][axis][direction] =
+                    static_cast<u8>(next);
+            }
+        }
+    }
+    FinishTable(table);
+    return table;
+}
+
+} // namespace detail
+
+// NOTE: Undefined gets an empty table so that a default block can be rotated
+inline constexpr OrientationTable orientation_tables[block_type_count + 1] = {
+    detail::MakeOrientationTable(BlockType::IShape),
+    detail::MakeOrientationTable(BlockType::LShape),
+    detail::MakeOrientationTable(BlockType::JShape),
+    detail::MakeOrientationTable(BlockType::OShape),
+    detail::MakeOrientationTable(BlockType::SShape),
+    detail::MakeOrientationTable(BlockType::TShape),
+    detail::MakeOrientationTable(BlockType::ZShape),
+    detail::MakeOrientationTable(BlockType::Undefined),
+};
+
+inline const OrientationTable& GetOrientationTable(BlockType type) {
+    return orientation_tables[static_cast<u32>(type)];
+}
+
+static_assert(orientation_tables[static_cast<u32>(BlockType::IShape)]
+                      .orientation_count == 6,
+              "a bar is invariant under the rotations about its axis");
+static_assert(orientation_tables[static_cast<u32>(BlockType::TShape)]
+                      .orientation_count == 12,
+              "a T is invariant under the half turn about its stem");
+
+} // namespace GameLogic
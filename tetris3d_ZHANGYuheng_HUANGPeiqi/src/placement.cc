@@ -0,0 +1,323 @@
+#include "placement.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+
+namespace GameLogic {
+
+namespace {
+
+// offsets of the Move* actions, the Rotate* actions follow them by axis then
+// direction
+const u32 move_count = 4;
+const glm::ivec3 move_offsets[move_count] = {
+    glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 0, 1),
+    glm::ivec3(0, 0, -1)};
+const u32 rotation_count = 6;
+
+static_assert(static_cast<u32>(Action::RotateXClockwise) == move_count &&
+                  static_cast<u32>(Action::RotateZCounterClockwise) ==
+                      move_count + rotation_count - 1,
+              "the search relies on the order of the actions");
+
+// flags of the search keys, the generation is in the bits above them
+const u8 key_tested = 1;
+const u8 key_fits = 2;
+const u8 key_visited = 4;
+const u8 key_landed = 8;
+const u32 key_flag_bits = 4;
+const u32 max_generation = 0xff >> key_flag_bits;
+// hover levels kept by a search, a block type has a few of them, one by
+// spawn and stack height
+const size_t max_hover_levels = 64;
+
+} // namespace
+
+template <typename Board>
+const std::vector<Placement>&
+PlacementSearch::Run(const BasicGameState<Board>& state) {
+    const auto& board = state.board;
+    nodes.clear();
+    placements.clear();
+
+    const auto& falling_block = state.falling_block;
+    if (falling_block.type == BlockType::Undefined ||
+        !falling_block.IsValid(board)) {
+        return placements;
+    }
+
+    // NOTE: the keys are only cleared when the board size changes, or once
+    // every max_generation runs when the generation wraps around. A byte
+    // per key keeps them in cache.
+    auto key_count = static_cast<size_t>(block_max_orientations) *
+                     board.width * board.height * board.depth;
+    auto size = glm::ivec3(board.width, board.height, board.depth);
+    if (board_size != size) {
+        board_size = size;
+        hover_levels.clear();
+    }
+    if (keys.size() != key_count || generation == max_generation) {
+        keys.assign(key_count, 0);
+        generation = 0;
+    }
+    ++generation;
+
+    const auto& table = GetOrientationTable(falling_block.type);
+
+    // the block in every orientation, and the directions of the fixes after
+    // every rotation, which only depend on the orientations
+    std::array<Block, block_max_orientations> blocks;
+    InlineVector<glm::ivec3, 4> fixes[block_max_orientations][rotation_count];
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        blocks[orientation] = falling_block;
+        blocks[orientation].SetOrientation(orientation);
+    }
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        for (u32 rotation = 0; rotation < rotation_count; ++rotation) {
+            auto next = table.next[orientation][rotation / 2][rotation % 2];
+            fixes[orientation][rotation] =
+                blocks[next].GetFixTranslations(blocks[orientation]);
+        }
+    }
+
+    // NOTE: every orientation has a cube at the block position, so a valid
+    // block has its position inside the board. The orientations of a
+    // position are next to each other, the rotations stay in cache.
+    auto key_at = [&](u32 orientation, const glm::ivec3& position) -> u8& {
+        auto& key = keys[((position.y * board.width + position.x) *
+                              board.depth +
+                          position.z) *
+                             block_max_orientations +
+                         orientation];
+        if (key >> key_flag_bits != generation) {
+            key = static_cast<u8>(generation << key_flag_bits);
+        }
+        return key;
+    };
+    // Add a node for the position when the block fits there and it was not
+    // visited yet, returns whether the block fits
+    auto reach = [&](u32 orientation, const glm::ivec3& position, u32 parent,
+                     Action action, i32 count) {
+        if (position.x < 0 || position.y < 0 || position.z < 0 ||
+            position.x >= static_cast<i32>(board.width) ||
+            position.y >= static_cast<i32>(board.height) ||
+            position.z >= static_cast<i32>(board.depth)) {
+            return false;
+        }
+        auto& key = key_at(orientation, position);
+        if (!(key & key_tested)) {
+            auto& block = blocks[orientation];
+            block.position = position;
+            key |= block.IsValid(board) ? key_tested | key_fits : key_tested;
+        }
+        if (!(key & key_fits)) {
+            return false;
+        }
+        if (key & key_visited) {
+            return true;
+        }
+        key |= key_visited;
+
+        Node node;
+        node.x = static_cast<i8>(position.x);
+        node.y = static_cast<i8>(position.y);
+        node.z = static_cast<i8>(position.z);
+        node.orientation = static_cast<u8>(orientation);
+        node.action = action;
+        node.count = static_cast<u8>(count);
+        node.parent = parent;
+        nodes.push_back(node);
+        return true;
+    };
+    reach(falling_block.orientation, falling_block.position, 0,
+          Action::SoftDrop, 0);
+
+    // hover height: every orientation clears the highest column. The holes
+    // are the free cells under the top of their column.
+    auto stack_height = 0U;
+    auto hole_top = -1;
+    for (u32 x = 0; x < board.width; ++x) {
+        for (u32 z = 0; z < board.depth; ++z) {
+            auto height = board.GetColumnHeight(x, z);
+            stack_height = std::max(stack_height, height);
+            for (auto y = static_cast<i32>(height) - 1; y > hole_top; --y) {
+                if (board.IsEmpty(glm::ivec3(x, y, z))) {
+                    hole_top = y;
+                }
+            }
+        }
+    }
+    auto reach_below = 0;
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        reach_below = std::max(reach_below, -table.min[orientation].y);
+    }
+    auto hover_drop = std::min(falling_block.position.y -
+                                   static_cast<i32>(stack_height) -
+                                   reach_below,
+                               ComputeDropDistance(falling_block, board));
+
+    // NOTE: nothing is reachable from the spawn height which is not from
+    // the hover height, so the spawn node is not expanded
+    u32 first_node = 0;
+    if (hover_drop > 0) {
+        reach(falling_block.orientation,
+              falling_block.position - glm::ivec3(0, hover_drop, 0), 0,
+              Action::SoftDrop, hover_drop);
+        first_node = 1;
+    }
+
+    // Add the nodes the moves and turns of the node reach
+    auto expand = [&](u32 i) {
+        auto node = nodes[i];
+        auto orientation = static_cast<u32>(node.orientation);
+        auto position = glm::ivec3(node.x, node.y, node.z);
+
+        for (u32 move = 0; move < move_count; ++move) {
+            reach(orientation, position + move_offsets[move], i,
+                  static_cast<Action>(move), 1);
+        }
+
+        // same as the Try*WithFix rotations: the rotated block when it fits,
+        // or else the first fix of TryFix which does
+        for (u32 rotation = 0; rotation < rotation_count; ++rotation) {
+            auto next = table.next[orientation][rotation / 2][rotation % 2];
+            auto action = static_cast<Action>(move_count + rotation);
+            if (reach(next, position, i, action, 1)) {
+                continue;
+            }
+            auto fixed = false;
+            for (i32 distance = 1;
+                 distance <= block_max_fix_distance && !fixed; ++distance) {
+                for (auto& translation : fixes[orientation][rotation]) {
+                    if (reach(next, position + distance * translation, i,
+                              action, 1)) {
+                        fixed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    };
+
+    // NOTE: the block clears the stack on the whole hover level, which only
+    // depends on the block, its spawn and the board size. It is searched
+    // once and its nodes are reused by the next runs, the moves and turns
+    // from the level stay on it.
+    auto level_end = 0U;
+    auto tuck_height = INT_MAX;
+    if (hover_drop > 0) {
+        auto level = std::find_if(
+            hover_levels.begin(), hover_levels.end(), [&](const auto& level) {
+                return level.type == falling_block.type &&
+                       level.orientation == falling_block.orientation &&
+                       level.position == falling_block.position &&
+                       level.drop == hover_drop;
+            });
+        if (level != hover_levels.end()) {
+            nodes = level->nodes;
+        } else {
+            for (auto i = first_node; i < nodes.size(); ++i) {
+                expand(i);
+            }
+            // every column in every orientation, unless the level is too
+            // close to the top of the board for some of them
+            size_t column_count = 0;
+            for (u32 orientation = 0; orientation < table.orientation_count;
+                 ++orientation) {
+                const auto& min = table.min[orientation];
+                const auto& max = table.max[orientation];
+                column_count += (board.width - (max.x - min.x)) *
+                                (board.depth - (max.z - min.z));
+            }
+            if (hover_levels.size() == max_hover_levels) {
+                hover_levels.clear();
+            }
+            hover_levels.push_back({falling_block.type,
+                                    falling_block.orientation,
+                                    falling_block.position, hover_drop,
+                                    nodes.size() - first_node == column_count,
+                                    nodes});
+            level = hover_levels.end() - 1;
+        }
+        level_end = static_cast<u32>(nodes.size());
+
+        // NOTE: a block is only slid or turned into a hole from the heights
+        // up to tuck_height. Higher up, what a move or a turn reaches is
+        // above the stack, where dropping from the hover level gets as well
+        // when the level has every column, and the block drops straight
+        // down there.
+        if (level->complete) {
+            tuck_height = hole_top < 0 ? -1 : hole_top + reach_below;
+        }
+    }
+
+    for (auto i = first_node; i < nodes.size(); ++i) {
+        if (i >= level_end && nodes[i].y <= tuck_height) {
+            expand(i);
+        }
+        auto node = nodes[i];
+        auto orientation = static_cast<u32>(node.orientation);
+        auto position = glm::ivec3(node.x, node.y, node.z);
+
+        // one cell at a time near the holes, the block can be slid and
+        // turned at every height on the way down
+        auto drop = 1;
+        if (position.y > tuck_height) {
+            auto& block = blocks[orientation];
+            block.position = position;
+            drop = std::min(ComputeDropDistance(block, board),
+                            position.y - tuck_height);
+        }
+        if (drop > 0 && reach(orientation, position - glm::ivec3(0, drop, 0),
+                              i, Action::SoftDrop, drop)) {
+            continue;
+        }
+
+        // the cubes are sorted, equal cube sets have the same shape and the
+        // same first cube
+        auto first = position + blocks[orientation].cube_offsets[0];
+        auto& key = key_at(table.shape[orientation], first);
+        if (!(key & key_landed)) {
+            key |= key_landed;
+            Placement placement;
+            placement.orientation = node.orientation;
+            placement.position = position;
+            placement.node = i;
+            placements.push_back(placement);
+        }
+    }
+    return placements;
+}
+
+void PlacementSearch::GetActions(const Placement& placement,
+                                 std::vector<Action>& actions) const {
+    actions.clear();
+    for (auto index = placement.node; index != 0;
+         index = nodes[index].parent) {
+        const auto& node = nodes[index];
+        actions.insert(actions.end(), node.count, node.action);
+    }
+    std::reverse(actions.begin(), actions.end());
+    actions.push_back(Action::HardDrop);
+}
+
+template <typename Board>
+std::vector<Placement> EnumeratePlacements(const BasicGameState<Board>& state) {
+    thread_local PlacementSearch search;
+    return search.Run(state);
+}
+
+#define INSTANTIATE_PLACEMENT(Board)                                           \
+    template const std::vector<Placement>& PlacementSearch::Run(               \
+        const BasicGameState<Board>&);                                         \
+    template std::vector<Placement> EnumeratePlacements(                       \
+        const BasicGameState<Board>&);
+
+INSTANTIATE_PLACEMENT(Board3D)
+INSTANTIATE_PLACEMENT(DynamicBoard3D)
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "glm/vec3.hpp"
+#include "logic.h"
+
+namespace GameLogic {
+
+// Resting position of the falling block, where a drop would merge it
+struct Placement {
+    u8 orientation = 0;
+    // position of the landed block
+    glm::ivec3 position = glm::ivec3(0);
+    // search node which reached it, see PlacementSearch::GetActions
+    u32 node = 0;
+
+    // The falling block moved to the placement
+    Block Place(const Block& block) const {
+        auto placed = block;
+        placed.SetOrientation(orientation);
+        placed.position = position;
+        return placed;
+    }
+};
+
+// Breadth first search of the placements of the falling block, with the
+// moves, rotation kicks and soft drops of Apply so that only what a player
+// can reach is found, tucks and spins under overhangs included. Positions
+// are keyed by (orientation, x, y, z), and each position is tested against
+// the board once.
+//
+// The block first drops straight to the hover height, the lowest one where
+// every orientation still clears the stack. The hover level does not depend
+// on the stack, its nodes are kept for the next runs. From there the block
+// drops straight down to the heights where it can be tucked into a hole,
+// and below them it is slid, turned and dropped one cell at a time down to
+// its landing heights.
+//
+// Placements with the same cubes, like a bar turned end over end, are
+// reported once. A search keeps its buffers between runs, one per thread.
+// The keys are stamped with the generation of the run which set them, so
+// they are not cleared before every run.
+class PlacementSearch {
+  public:
+    template <typename Board>
+    const std::vector<Placement>& Run(const BasicGameState<Board>& state);
+
+    const std::vector<Placement>& GetPlacements() const { return placements; }
+
+    // Actions bringing the falling block of the last run to the placement,
+    // ending with the HardDrop which merges it
+    void GetActions(const Placement& placement,
+                    std::vector<Action>& actions) const;
+
+  private:
+    struct Node {
+        i8 x = 0;
+        i8 y = 0;
+        i8 z = 0;
+        u8 orientation = 0;
+        // action reaching the node from its parent, repeated count times
+        Action action = Action::SoftDrop;
+        u8 count = 0;
+        u32 parent = 0;
+    };
+
+    // Nodes reached on the hover level, from the spawn node and the node
+    // dropped to the level
+    struct HoverLevel {
+        BlockType type = BlockType::Undefined;
+        u8 orientation = 0;
+        // of the spawned block
+        glm::ivec3 position = glm::ivec3(0);
+        i32 drop = 0;
+        // whether the block reaches every column in every orientation
+        bool complete = false;
+        std::vector<Node> nodes;
+    };
+
+    std::vector<Node> nodes;
+    // by position and orientation: the generation of the run which last
+    // touched the key, over whether the position was tested and fits, was
+    // visited, and whether the cube set with this shape and first cube was
+    // placed
+    std::vector<u8> keys;
+    u32 generation = 0;
+    glm::ivec3 board_size = glm::ivec3(0);
+    std::vector<HoverLevel> hover_levels;
+    std::vector<Placement> placements;
+};
+
+// Every distinct placement the falling block can reach, see PlacementSearch
+template <typename Board>
+std::vector<Placement> EnumeratePlacements(const BasicGameState<Board>& state);
+
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.h"
+
+// xoshiro256** random number generator. Every game owns one, so a game is
+// reproduced from its seed and games on different threads share nothing.
+class Rng {
+  public:
+    explicit Rng(u64 seed = 0) { Seed(seed); }
+
+    // The state is expanded from the seed with splitmix64, so that it is
+    // never all zero
+    void Seed(u64 seed) {
+        for (auto& word : state) {
+            seed += 0x9e3779b97f4a7c15;
+            auto z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    u64 Next() {
+        auto result = RotateLeft(state[1] * 5, 7) * 9;
+        auto t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = RotateLeft(state[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound), from the high bits without a division
+    u32 Below(u32 bound) {
+        return static_cast<u32>(((Next() >> 32) * bound) >> 32);
+    }
+
+    u64 state[4];
+
+  private:
+    static u64 RotateLeft(u64 x, int k) { return (x << k) | (x >> (64 - k)); }
+};
@@ -1,5 +1,7 @@
 #include "renderer.h"
 
+#include <cstring>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -584,6 +586,7 @@ void AdvancedRenderer::Initialize(const GameLogic::GameState& state) {
     skybox_shader.Create(skybox_vs, skybox_fs);
     tetris_cube.Create(1.f, 1.f, 1.f);
     board_bounds.Create(state.board);
+    UpdatePalette(state.palette);
     skybox.Create();
     font.SetSize(5);
 }
@@ -614,6 +617,8 @@ void AdvancedRenderer::Render(const GameLogic::GameState& state,
 
     board_bounds.Render(solid_wire_shader, Color{0.3f, 0.3f, 0.3f}, camera);
 
+    UpdatePalette(state.palette);
+
     RenderBoard(state.board, camera);
     RenderFallingBlock(state.falling_block, camera);
     if (state.phase == GameLogic::GameState::Phase::BlockFalling) {
@@ -644,18 +649,28 @@ void AdvancedRenderer::Render(const GameLogic::GameState& state,
     }
 }
 
+void AdvancedRenderer::UpdatePalette(const Palette& palette) {
+    if (!memcmp(palette_source.data(), palette.colors.data(),
+                sizeof(palette_source))) {
+        return;
+    }
+    palette_source = palette.colors;
+    for (size_t i = 0; i < palette_colors.size(); ++i) {
+        palette_colors[i] = ToColor(palette_source[i]);
+    }
+}
+
 void AdvancedRenderer::RenderBoard(const GameLogic::Board3D& board,
                                    const Camera& camera) {
     for (size_t k = 0; k < board.height; ++k) {
         for (size_t i = 0; i < board.width; ++i) {
             for (size_t j = 0; j < board.depth; ++j) {
-                auto index =
-                    (i * board.width + j) + (k * board.width * board.depth);
+                auto index = board.PositionToIndex(glm::ivec3(i, k, j));
                 if (board.cells[index]) {
                     auto position = glm::vec3(i, k, j);
-                    Color color = FromPackedColorToColor(board.cells[index]);
                     RenderCube_style1(position + glm::vec3(0.5f, 0.5f, 0.5f),
-                                     color, camera);
+                                     palette_colors[board.cells[index]],
+                                     camera);
                 }
             }
         }
@@ -664,10 +679,7 @@ void AdvancedRenderer::RenderBoard(const GameLogic::Board3D& board,
 
 void AdvancedRenderer::RenderFallingBlock(const GameLogic::Block& block,
                                           const Camera& camera) {
-    Color color;
-    color.r = block.color.r / 255.f;
-    color.g = block.color.g / 255.f;
-    color.b = block.color.b / 255.f;
+    const auto& color = palette_colors[block.color];
 
     for (auto& offset : block.cube_offsets) {
         auto position =
@@ -678,11 +690,19 @@ void AdvancedRenderer::RenderFallingBlock(const GameLogic::Block& block,
 
 void AdvancedRenderer::RenderFallingBlockProjection(
     const GameLogic::GameState& state, const Camera& camera) {
-    auto projected_block = state.falling_block;
-    while (projected_block.IsValid(state.board)) {
-        projected_block.Translate(glm::ivec3(0, -1, 0));
+    const auto& block = state.falling_block;
+    if (!projection_valid ||
+        projection_board_revision != state.board.revision ||
+        projection_source.type != block.type ||
+        projection_source.orientation != block.orientation ||
+        projection_source.position != block.position) {
+        projection_source = block;
+        projected_block = block;
+        projected_block.Translate(
+            glm::ivec3(0, -GameLogic::ComputeDropDistance(state), 0));
+        projection_board_revision = state.board.revision;
+        projection_valid = true;
     }
-    projected_block.Translate(glm::ivec3(0, 1, 0));
 
     Color color{0.9, 0.9f, 0.9f, 0.6f};
 
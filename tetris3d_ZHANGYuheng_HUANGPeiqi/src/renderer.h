@@ -110,6 +110,7 @@ class AdvancedRenderer : public IRenderer {
     }
 
   private:
+    void UpdatePalette(const Palette& palette);
     void RenderBoard(const GameLogic::Board3D& board, const Camera& camera);
     void RenderFallingBlock(const GameLogic::Block& block,
                             const Camera& camera);
@@ -133,4 +134,15 @@ class AdvancedRenderer : public IRenderer {
     BoardBounds board_bounds;
     SkyBox skybox;
     Scoreboard font;
+
+    // colors of the palette of the game, converted once
+    std::array<ColorR8G8B8, 256> palette_source;
+    std::array<Color, 256> palette_colors;
+
+    // the projection is only recomputed when the falling block moves or the
+    // board changes
+    GameLogic::Block projection_source;
+    GameLogic::Block projected_block;
+    u32 projection_board_revision = 0;
+    bool projection_valid = false;
 };
@@ -0,0 +1,354 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace GameLogic {
+
+namespace {
+
+const char replay_magic[4] = {'T', '3', 'D', 'R'};
+const u32 replay_version = 1;
+
+// encoded bytes handed to the flush thread at once
+const size_t replay_flush_bytes = 4096;
+// longest time events wait in memory before reaching the file
+const auto replay_flush_period = std::chrono::seconds(1);
+
+void PutU32(std::vector<u8>& bytes, u32 value) {
+    for (u32 i = 0; i < 4; ++i) {
+        bytes.push_back(static_cast<u8>(value >> (8 * i)));
+    }
+}
+
+void PutU64(std::vector<u8>& bytes, u64 value) {
+    for (u32 i = 0; i < 8; ++i) {
+        bytes.push_back(static_cast<u8>(value >> (8 * i)));
+    }
+}
+
+u32 GetU32(const u8* bytes) {
+    u32 value = 0;
+    for (u32 i = 0; i < 4; ++i) {
+        value |= static_cast<u32>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+u64 GetU64(const u8* bytes) {
+    u64 value = 0;
+    for (u32 i = 0; i < 8; ++i) {
+        value |= static_cast<u64>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+// LEB128, 7 bits per byte with the high bit set on all but the last byte
+void PutVarint(std::vector<u8>& bytes, u64 value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<u8>(value));
+}
+
+bool GetVarint(const std::vector<u8>& bytes, size_t& offset, u64& value) {
+    value = 0;
+    for (u32 shift = 0; shift < 64 && offset < bytes.size(); shift += 7) {
+        auto byte = bytes[offset++];
+        value |= static_cast<u64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ReplayHeader ReplayHeader::Create(u64 seed,
+                                  Settings::BlockGenerator block_generator) {
+    ReplayHeader header;
+    header.version = replay_version;
+    header.seed = seed;
+    header.block_generator = static_cast<u32>(block_generator);
+    header.tick_rate_hz = Settings::logic_tick_rate_hz;
+    header.map_width = Settings::map_width;
+    header.map_depth = Settings::map_depth;
+    header.map_height = Settings::map_height;
+    header.block_init_fall_step_ticks = Settings::block_init_fall_step_ticks;
+    header.block_max_fall_step_ticks = Settings::block_max_fall_step_ticks;
+    header.block_speed_inc_percent = Settings::block_speed_inc_percent;
+    header.block_speed_inc_period_ticks =
+        Settings::block_speed_inc_period_ticks;
+    return header;
+}
+
+void ReplayHeader::Write(std::vector<u8>& bytes) const {
+    bytes.insert(bytes.end(), replay_magic, replay_magic + 4);
+    PutU32(bytes, version);
+    PutU64(bytes, seed);
+    PutU32(bytes, block_generator);
+    PutU32(bytes, tick_rate_hz);
+    PutU32(bytes, map_width);
+    PutU32(bytes, map_depth);
+    PutU32(bytes, map_height);
+    PutU32(bytes, block_init_fall_step_ticks);
+    PutU32(bytes, block_max_fall_step_ticks);
+    PutU32(bytes, block_speed_inc_percent);
+    PutU32(bytes, block_speed_inc_period_ticks);
+}
+
+bool ReplayHeader::Read(const u8* bytes, size_t count) {
+    if (count < size || memcmp(bytes, replay_magic, 4)) {
+        return false;
+    }
+    version = GetU32(bytes + 4);
+    seed = GetU64(bytes + 8);
+    block_generator = GetU32(bytes + 16);
+    tick_rate_hz = GetU32(bytes + 20);
+    map_width = GetU32(bytes + 24);
+    map_depth = GetU32(bytes + 28);
+    map_height = GetU32(bytes + 32);
+    block_init_fall_step_ticks = GetU32(bytes + 36);
+    block_max_fall_step_ticks = GetU32(bytes + 40);
+    block_speed_inc_percent = GetU32(bytes + 44);
+    block_speed_inc_period_ticks = GetU32(bytes + 48);
+    return version == replay_version;
+}
+
+bool ReplayHeader::HasSameRules(const ReplayHeader& other) const {
+    return version == other.version && tick_rate_hz == other.tick_rate_hz &&
+           map_width == other.map_width && map_depth == other.map_depth &&
+           map_height == other.map_height &&
+           block_init_fall_step_ticks == other.block_init_fall_step_ticks &&
+           block_max_fall_step_ticks == other.block_max_fall_step_ticks &&
+           block_speed_inc_percent == other.block_speed_inc_percent &&
+           block_speed_inc_period_ticks == other.block_speed_inc_period_ticks;
+}
+
+ReplayWriter::~ReplayWriter() {
+    if (IsOpen()) {
+        Close(last_tick);
+    }
+}
+
+bool ReplayWriter::Open(const char* path, const ReplayHeader& header) {
+    assert(!IsOpen());
+    file = fopen(path, "wb");
+    if (!file) {
+        printf("Failed to open replay file: %s\n", path);
+        return false;
+    }
+
+    last_tick = 0;
+    accelerating = false;
+    closing = false;
+    pending.clear();
+    header.Write(pending);
+    flush_thread = std::thread([this] { FlushLoop(); });
+    data_available.notify_one();
+    return true;
+}
+
+void ReplayWriter::RecordAction(u64 tick, Action action) {
+    Record(tick, static_cast<u32>(action));
+}
+
+void ReplayWriter::RecordAccelerate(u64 tick, bool accelerate) {
+    if (accelerate == accelerating) {
+        return;
+    }
+    accelerating = accelerate;
+    Record(tick, static_cast<u32>(accelerate ? ReplayEventType::AccelerateOn
+                                             : ReplayEventType::AccelerateOff));
+}
+
+void ReplayWriter::Close(u64 tick) {
+    if (!IsOpen()) {
+        return;
+    }
+    Record(tick, static_cast<u32>(ReplayEventType::End));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    data_available.notify_one();
+    flush_thread.join();
+
+    fclose(file);
+    file = nullptr;
+}
+
+void ReplayWriter::Record(u64 tick, u32 code) {
+    if (!IsOpen()) {
+        return;
+    }
+    assert(tick >= last_tick);
+    auto delta = tick - last_tick;
+    last_tick = tick;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    PutVarint(pending, delta << 4 | code);
+    if (pending.size() >= replay_flush_bytes) {
+        data_available.notify_one();
+    }
+}
+
+void ReplayWriter::FlushLoop() {
+    std::vector<u8> writing;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        data_available.wait_for(lock, replay_flush_period, [this] {
+            return closing || pending.size() >= replay_flush_bytes;
+        });
+        auto done = closing;
+        writing.swap(pending);
+        lock.unlock();
+
+        if (!writing.empty()) {
+            fwrite(writing.data(), 1, writing.size(), file);
+            fflush(file);
+            writing.clear();
+        }
+        if (done) {
+            return;
+        }
+        lock.lock();
+    }
+}
+
+bool ReplayReader::Open(const char* path) {
+    auto file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open replay file: %s\n", path);
+        return false;
+    }
+    bytes.clear();
+    u8 chunk[4096];
+    for (size_t count; (count = fread(chunk, 1, sizeof(chunk), file));) {
+        bytes.insert(bytes.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    if (!header.Read(bytes.data(), bytes.size())) {
+        printf("Not a replay of this version: %s\n", path);
+        return false;
+    }
+    position = Position();
+    return true;
+}
+
+bool ReplayReader::Next(ReplayEvent& event) {
+    u64 value = 0;
+    auto offset = position.offset;
+    if (!GetVarint(bytes, offset, value)) {
+        return false;
+    }
+    position.offset = offset;
+    position.tick += value >> 4;
+    event.tick = position.tick;
+    event.type = static_cast<ReplayEventType>(value & 0xf);
+    return event.type != ReplayEventType::End;
+}
+
+bool ReplayPlayer::Open(const char* path) {
+    if (!reader.Open(path)) {
+        return false;
+    }
+    const auto& header = reader.GetHeader();
+    if (!header.HasSameRules(ReplayHeader::Create(
+            header.seed, Settings::BlockGenerator::Uniform))) {
+        printf("Replay recorded with other rules: %s\n", path);
+        return false;
+    }
+
+    // the end is the End event, or the last event of a cut recording
+    ReplayEvent event;
+    while (reader.Next(event)) {
+    }
+    end_tick = event.tick;
+
+    state = GameState(header.seed, static_cast<Settings::BlockGenerator>(
+                                       header.block_generator));
+    blocks = 0;
+    accelerating = false;
+    reader.SetPosition(ReplayReader::Position());
+    ReadNextEvent();
+
+    keyframes.clear();
+    AddKeyframe();
+    return true;
+}
+
+void ReplayPlayer::Advance(u64 ticks) {
+    for (; ticks && !IsFinished(); --ticks) {
+        StepTick();
+    }
+}
+
+void ReplayPlayer::Seek(u64 tick) {
+    tick = std::min(tick, end_tick);
+
+    // last keyframe at or before the target
+    auto keyframe = std::upper_bound(
+        keyframes.begin(), keyframes.end(), tick,
+        [](u64 tick, const Keyframe& keyframe) {
+            return tick < keyframe.tick;
+        });
+    --keyframe;
+    if (tick < state.tick || keyframe->tick > state.tick) {
+        Restore(*keyframe);
+    }
+    Advance(tick - state.tick);
+}
+
+void ReplayPlayer::StepTick() {
+    while (has_next_event && next_event.tick == state.tick) {
+        if (next_event.IsAction()) {
+            Apply(state, next_event.GetAction());
+        } else {
+            accelerating = next_event.type == ReplayEventType::AccelerateOn;
+        }
+        ReadNextEvent();
+    }
+
+    auto phase = state.phase;
+    processGameUpdate(state, accelerating);
+    if (state.phase != GamePhase::NewBlockCreation ||
+        phase == GamePhase::NewBlockCreation) {
+        return;
+    }
+
+    // keyframes are only added past the furthest point played so far
+    if (++blocks % Settings::replay_keyframe_blocks == 0 &&
+        state.tick > keyframes.back().tick) {
+        AddKeyframe();
+    }
+}
+
+void ReplayPlayer::ReadNextEvent() {
+    event_position = reader.GetPosition();
+    has_next_event = reader.Next(next_event);
+}
+
+void ReplayPlayer::AddKeyframe() {
+    keyframes.emplace_back();
+    auto& keyframe = keyframes.back();
+    keyframe.tick = state.tick;
+    SaveSnapshot(state, keyframe.snapshot);
+    keyframe.position = event_position;
+    keyframe.accelerating = accelerating;
+    keyframe.blocks = blocks;
+}
+
+void ReplayPlayer::Restore(const Keyframe& keyframe) {
+    RestoreSnapshot(state, keyframe.snapshot);
+    accelerating = keyframe.accelerating;
+    blocks = keyframe.blocks;
+    reader.SetPosition(keyframe.position);
+    ReadNextEvent();
+}
+
+}
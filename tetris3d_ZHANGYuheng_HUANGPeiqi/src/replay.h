@@ -0,0 +1,183 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "logic.h"
+#include "settings.h"
+
+namespace GameLogic {
+
+// Replay file layout, all integers little endian:
+//   header  see ReplayHeader::Write
+//   events  one varint per event: tick delta << 4 | ReplayEventType, where
+//           the tick delta counts from the previous event. The action codes
+//           are the values of Action.
+//
+// A game is the seed and the inputs applied on each tick: the actions,
+// before processGameUpdate, and the changes of the accelerate flag. Actions
+// which had no effect are not recorded.
+
+enum class ReplayEventType : u8 {
+    // [0, action_count) are actions
+    AccelerateOn = 12,
+    AccelerateOff = 13,
+    // the game stopped at the tick of the event
+    End = 15
+};
+
+static_assert(action_count <= static_cast<u32>(ReplayEventType::AccelerateOn),
+              "the actions share the event codes");
+
+struct ReplayEvent {
+    u64 tick = 0;
+    ReplayEventType type = ReplayEventType::End;
+
+    bool IsAction() const { return static_cast<u32>(type) < action_count; }
+    Action GetAction() const { return static_cast<Action>(type); }
+};
+
+// Seed and rules of a recorded game. A replay only plays back with the rules
+// it was recorded with.
+struct ReplayHeader {
+    // header of a game of this build
+    static ReplayHeader Create(u64 seed,
+                               Settings::BlockGenerator block_generator);
+
+    // bytes of the header in the file
+    static const u32 size = 52;
+
+    void Write(std::vector<u8>& bytes) const;
+    bool Read(const u8* bytes, size_t count);
+
+    // Whether the games of the other header play the same in this build
+    bool HasSameRules(const ReplayHeader& other) const;
+
+    u32 version = 0;
+    u64 seed = 0;
+    u32 block_generator = 0;
+    u32 tick_rate_hz = 0;
+    u32 map_width = 0;
+    u32 map_depth = 0;
+    u32 map_height = 0;
+    u32 block_init_fall_step_ticks = 0;
+    u32 block_max_fall_step_ticks = 0;
+    u32 block_speed_inc_percent = 0;
+    u32 block_speed_inc_period_ticks = 0;
+};
+
+// Streams the events of a game to a replay file. Events are encoded into
+// memory and a background thread writes them, so recording never waits on
+// the disk.
+class ReplayWriter {
+  public:
+    ReplayWriter() = default;
+    ~ReplayWriter();
+
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+    bool Open(const char* path, const ReplayHeader& header);
+    bool IsOpen() const { return file != nullptr; }
+
+    void RecordAction(u64 tick, Action action);
+    // Only the changes of the flag are written
+    void RecordAccelerate(u64 tick, bool accelerate);
+
+    // Write the end of the game and wait until everything is in the file
+    void Close(u64 tick);
+
+  private:
+    void Record(u64 tick, u32 code);
+    void FlushLoop();
+
+    FILE* file = nullptr;
+    u64 last_tick = 0;
+    bool accelerating = false;
+
+    std::thread flush_thread;
+    std::mutex mutex;
+    std::condition_variable data_available;
+    // encoded bytes not handed to the file yet
+    std::vector<u8> pending;
+    bool closing = false;
+};
+
+// Decodes a replay file loaded in memory
+class ReplayReader {
+  public:
+    // Where the reader is in the event stream, to come back to it later
+    struct Position {
+        size_t offset = ReplayHeader::size;
+        u64 tick = 0;
+    };
+
+    bool Open(const char* path);
+
+    const ReplayHeader& GetHeader() const { return header; }
+
+    // Next event, false at the end of the stream
+    bool Next(ReplayEvent& event);
+
+    Position GetPosition() const { return position; }
+    void SetPosition(const Position& value) { position = value; }
+
+  private:
+    std::vector<u8> bytes;
+    ReplayHeader header;
+    Position position;
+};
+
+// Plays a replay through the game rules. Every replay_keyframe_blocks new
+// blocks a snapshot of the game is kept, so seeking restores the closest
+// snapshot before the target and simulates the few ticks left.
+class ReplayPlayer {
+  public:
+    bool Open(const char* path);
+
+    const GameState& GetState() const { return state; }
+    // tick at which the recorded game stopped
+    u64 GetEndTick() const { return end_tick; }
+    bool IsFinished() const { return state.tick >= end_tick; }
+    u64 GetBlockCount() const { return blocks; }
+
+    // Simulate the given number of ticks, or until the end
+    void Advance(u64 ticks);
+    // Move to the given tick, backwards or forwards
+    void Seek(u64 tick);
+
+  private:
+    struct Keyframe {
+        u64 tick = 0;
+        GameSnapshot snapshot;
+        ReplayReader::Position position;
+        bool accelerating = false;
+        u64 blocks = 0;
+    };
+
+    void StepTick();
+    void ReadNextEvent();
+    void AddKeyframe();
+    void Restore(const Keyframe& keyframe);
+
+    ReplayReader reader;
+    GameState state;
+    u64 end_tick = 0;
+    // blocks created so far
+    u64 blocks = 0;
+    bool accelerating = false;
+
+    // next event to apply, read from event_position
+    ReplayEvent next_event;
+    bool has_next_event = false;
+    ReplayReader::Position event_position;
+
+    // sorted by tick
+    std::vector<Keyframe> keyframes;
+};
+
+};
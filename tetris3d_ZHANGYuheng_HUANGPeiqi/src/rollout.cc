@@ -0,0 +1,159 @@
+#include "rollout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+namespace GameLogic {
+
+namespace {
+
+// rollouts of a candidate played by one task
+const u32 rollouts_per_task = 2;
+
+u64 NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+u32 GetStackHeight(const Board3D& board) {
+    return *std::max_element(board.column_heights.begin(),
+                             board.column_heights.end());
+}
+
+} // namespace
+
+RolloutPolicy::RolloutPolicy(const BotWeights& weights) : bot(weights) {}
+
+bool RolloutPolicy::Play(GameState& state, u32& cleared) {
+    const auto& placements = search.Run(state);
+    if (placements.empty()) {
+        return false;
+    }
+    bot.ExtractFeatures(state, placements, features);
+    bot.Score(features, scores);
+    auto best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+    state.falling_block = placements[best].Place(state.falling_block);
+    cleared += LandFallingBlock(state);
+    return state.phase != GamePhase::Lost;
+}
+
+f32 PlayRollout(GameState& state, const RolloutLimits& limits,
+                RolloutPolicy& policy) {
+    auto placed = 0U;
+    auto cleared = 0U;
+    auto height = GetStackHeight(state.board);
+    while (placed < limits.max_depth && height < limits.danger_height) {
+        if (!policy.Play(state, cleared)) {
+            height = limits.danger_height;
+            break;
+        }
+        height = GetStackHeight(state.board);
+        if (height < limits.danger_height) {
+            ++placed;
+        }
+    }
+    auto room = static_cast<f32>(limits.danger_height) -
+                static_cast<f32>(std::min(height, limits.danger_height));
+    return placed + room / limits.danger_height +
+           limits.cleared_layer_value * cleared;
+}
+
+RolloutBot::RolloutBot(const RolloutLimits& limits, const BotWeights& weights,
+                       u32 thread_count)
+    : limits(limits), pool(thread_count), bot(weights) {
+    for (u32 i = 0; i < pool.GetThreadCount(); ++i) {
+        policies.push_back(std::make_unique<RolloutPolicy>(weights));
+    }
+}
+
+const std::vector<f32>& RolloutBot::Evaluate(const GameState& state) {
+    const auto& placements = search.Run(state);
+    auto count = placements.size();
+    values.assign(count, std::numeric_limits<f32>::lowest());
+    if (count == 0) {
+        return values;
+    }
+
+    // the heuristic picks the candidates, best first
+    bot.ExtractFeatures(state, placements, features);
+    bot.Score(features, scores);
+    candidates.resize(count);
+    std::iota(candidates.begin(), candidates.end(), 0);
+    auto candidate_count =
+        limits.candidates ? std::min<size_t>(limits.candidates, count) : count;
+    std::partial_sort(candidates.begin(),
+                      candidates.begin() + candidate_count, candidates.end(),
+                      [&](u32 a, u32 b) {
+                          return scores[a] > scores[b] ||
+                                 (scores[a] == scores[b] && a < b);
+                      });
+    candidates.resize(candidate_count);
+
+    auto start = NowNanoseconds();
+    auto tasks_per_candidate =
+        (limits.rollouts + rollouts_per_task - 1) / rollouts_per_task;
+    task_values.assign(candidate_count * tasks_per_candidate, 0.0);
+    for (size_t candidate = 0; candidate < candidate_count; ++candidate) {
+        for (u32 task = 0; task < tasks_per_candidate; ++task) {
+            pool.Submit([&, candidate, task](u32 worker) {
+                auto index = candidate * tasks_per_candidate + task;
+                Rng rng(limits.seed + state.tick * 0x9e3779b97f4a7c15 +
+                        index);
+                auto block = placements[candidates[candidate]].Place(
+                    state.falling_block);
+
+                auto first = task * rollouts_per_task;
+                auto last = std::min(first + rollouts_per_task,
+                                     limits.rollouts);
+                auto sum = 0.0;
+                for (auto i = first; i < last; ++i) {
+                    // NOTE: landing deals the next block, which has to come
+                    // from the stream of the rollout as well
+                    auto rollout = state;
+                    rollout.rng.Seed(rng.Next());
+                    rollout.falling_block = block;
+                    auto erased = LandFallingBlock(rollout);
+                    sum += limits.cleared_layer_value * erased;
+                    if (rollout.phase != GamePhase::Lost) {
+                        sum += PlayRollout(rollout, limits, *policies[worker]);
+                    }
+                }
+                task_values[index] = sum;
+            });
+        }
+    }
+    pool.Wait();
+    rollout_count += candidate_count * limits.rollouts;
+    rollout_nanoseconds += NowNanoseconds() - start;
+
+    // summed in a fixed order, whatever the order the tasks ran in
+    for (size_t candidate = 0; candidate < candidate_count; ++candidate) {
+        auto sum = 0.0;
+        for (u32 task = 0; task < tasks_per_candidate; ++task) {
+            sum += task_values[candidate * tasks_per_candidate + task];
+        }
+        values[candidates[candidate]] =
+            static_cast<f32>(sum / std::max(limits.rollouts, 1u));
+    }
+    return values;
+}
+
+bool RolloutBot::Think(const GameState& state, std::vector<Action>& actions) {
+    if (Evaluate(state).empty()) {
+        return false;
+    }
+    // NOTE: the first of equal values is the one the heuristic prefers
+    auto best = candidates[0];
+    for (auto candidate : candidates) {
+        if (values[candidate] > values[best]) {
+            best = candidate;
+        }
+    }
+    search.GetActions(search.GetPlacements()[best], actions);
+    return true;
+}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "bot.h"
+#include "common.h"
+#include "logic.h"
+#include "placement.h"
+#include "random.h"
+#include "settings.h"
+#include "thread_pool.h"
+
+namespace GameLogic {
+
+// Size of the Monte Carlo evaluation of a block
+struct RolloutLimits {
+    // placements with the best heuristic scores which are played out, 0 for
+    // all of them
+    u32 candidates = 8;
+    // games played out from each candidate
+    u32 rollouts = 4;
+    // blocks played by a rollout at most, after the candidate
+    u32 max_depth = 3;
+    // a rollout stops early once the stack reaches this height
+    u32 danger_height = Settings::map_height - 4;
+    // value of an erased layer, in blocks placed
+    f32 cleared_layer_value = 4.f;
+    // base of the random streams, with the tick of the game
+    u64 seed = 1;
+};
+
+// Player scoring the placements of the falling block by random games played
+// out from the board each one leaves, a slow but strong reference for
+// tuning the heuristic bots.
+//
+// A rollout deals its blocks from its own random stream, not from the
+// stream of the game, the block dealt when the candidate lands included,
+// and plays each one where the heuristic bot would. Its value is the number
+// of blocks it placed before the stack reached the danger height, plus the
+// layers it erased, the candidate included, and the room left under that
+// height at the end. The rollouts run in parallel on a thread pool, in
+// tasks with their own streams derived from the seed, so the values do not
+// depend on the thread count.
+class RolloutPolicy;
+
+class RolloutBot {
+  public:
+    explicit RolloutBot(const RolloutLimits& limits = RolloutLimits(),
+                        const BotWeights& weights = BotWeights(),
+                        u32 thread_count = ThreadPool::DefaultThreadCount());
+
+    // Mean rollout value of every placement of the falling block of state,
+    // in the order of GetPlacements. The placements which are not candidates
+    // get the lowest value.
+    const std::vector<f32>& Evaluate(const GameState& state);
+    const std::vector<Placement>& GetPlacements() const {
+        return search.GetPlacements();
+    }
+
+    // Actions bringing the falling block to its best placement and landing
+    // it, false when it has nowhere to go
+    bool Think(const GameState& state, std::vector<Action>& actions);
+
+    // Rollouts played and their time, since the creation of the bot
+    u64 GetRolloutCount() const { return rollout_count; }
+    u64 GetRolloutNanoseconds() const { return rollout_nanoseconds; }
+
+  private:
+    RolloutLimits limits;
+    ThreadPool pool;
+    HeuristicBot bot;
+    PlacementSearch search;
+    PlacementFeatures features;
+    std::vector<f32> scores;
+    std::vector<u32> candidates;
+    // summed values of every task
+    std::vector<f64> task_values;
+    std::vector<f32> values;
+    // by pool thread
+    std::vector<std::unique_ptr<RolloutPolicy>> policies;
+
+    u64 rollout_count = 0;
+    u64 rollout_nanoseconds = 0;
+};
+
+// Heuristic player of the rollouts, with its own buffers, one per thread
+class RolloutPolicy {
+  public:
+    explicit RolloutPolicy(const BotWeights& weights = BotWeights());
+
+    // Land the falling block on the best placement of the heuristic bot and
+    // add the layers it erased to cleared, false when the game is lost
+    bool Play(GameState& state, u32& cleared);
+
+  private:
+    HeuristicBot bot;
+    PlacementSearch search;
+    PlacementFeatures features;
+    std::vector<f32> scores;
+};
+
+// Play the game from the falling block, see RolloutBot. The blocks come from
+// the stream of state, which the caller seeds. Returns the value of the
+// rollout.
+f32 PlayRollout(GameState& state, const RolloutLimits& limits,
+                RolloutPolicy& policy);
+
+};
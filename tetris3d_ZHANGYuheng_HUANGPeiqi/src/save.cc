@@ -0,0 +1,400 @@
+#include "save.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GameLogic {
+
+namespace {
+
+const char save_magic[4] = {'T', '3', 'D', 'S'};
+const u32 save_version = 2;
+// the state starts on its own cache line
+const u64 save_state_offset = 64;
+
+static_assert(sizeof(SaveHeader) <= save_state_offset,
+              "the header has to fit before the state");
+static_assert(save_state_offset % alignof(GameState) == 0,
+              "the state can be read in place from the mapping");
+
+// Read only view of a whole file
+class MappedFile {
+  public:
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data) {
+            munmap(const_cast<u8*>(data), size);
+        }
+#endif
+    }
+
+    bool Open(const char* path) {
+#ifdef _WIN32
+        // NOTE: no mmap, the file is small enough to be read at once
+        auto file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        u8 chunk[4096];
+        for (size_t count; (count = fread(chunk, 1, sizeof(chunk), file));) {
+            buffer.insert(buffer.end(), chunk, chunk + count);
+        }
+        fclose(file);
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+#else
+        auto fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) || info.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        auto mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                            fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const u8*>(mapping);
+        size = info.st_size;
+        return true;
+#endif
+    }
+
+    const u8* data = nullptr;
+    size_t size = 0;
+
+  private:
+#ifdef _WIN32
+    std::vector<u8> buffer;
+#endif
+};
+
+void HashValue(u64& hash, u64 value) {
+    for (u32 i = 0; i < 8; ++i) {
+        hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 0x100000001b3;
+    }
+}
+
+void HashBytes(u64& hash, const u8* bytes, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+}
+
+// Offset of a member inside its object
+// NOTE: taken from an instance, offsetof is not defined for the types which
+// are not standard layout, like the boards
+template <typename T, typename Member>
+u64 MemberOffset(const T& object, const Member& member) {
+    return reinterpret_cast<const u8*>(&member) -
+           reinterpret_cast<const u8*>(&object);
+}
+
+// Offsets of every member of the state and of its parts
+void HashMemberOffsets(u64& hash) {
+    GameState state;
+    const auto& board = state.board;
+    const auto& block = state.falling_block;
+    const auto& randomizer = state.randomizer;
+    const u64 offsets[] = {
+        MemberOffset(state, state.board),
+        MemberOffset(state, state.falling_block),
+        MemberOffset(state, state.score),
+        MemberOffset(state, state.level),
+        MemberOffset(state, state.phase),
+        MemberOffset(state, state.paused),
+        MemberOffset(state, state.seed),
+        MemberOffset(state, state.rng),
+        MemberOffset(state, state.randomizer),
+        MemberOffset(state, state.tick),
+        MemberOffset(state, state.gravity_level),
+        MemberOffset(state, state.block_fall_step_ticks),
+        MemberOffset(state, state.ticks_to_next_block_fall),
+        MemberOffset(state, state.ticks_to_next_speed_inc),
+        MemberOffset(state, state.palette),
+        MemberOffset(board, board.cells),
+        MemberOffset(board, board.layers),
+        MemberOffset(board, board.layer_fill_counts),
+        MemberOffset(board, board.layer_hashes),
+        MemberOffset(board, board.layer_dirty),
+        MemberOffset(board, board.dirty_layers),
+        MemberOffset(board, board.column_heights),
+        MemberOffset(board, board.revision),
+        MemberOffset(board, board.hash),
+        MemberOffset(block, block.type),
+        MemberOffset(block, block.orientation),
+        MemberOffset(block, block.position),
+        MemberOffset(block, block.cube_offsets),
+        MemberOffset(block, block.color),
+        MemberOffset(randomizer, randomizer.generator),
+        MemberOffset(randomizer, randomizer.bag),
+        MemberOffset(randomizer, randomizer.bag_size),
+        MemberOffset(state.palette, state.palette.size),
+    };
+    for (auto offset : offsets) {
+        HashValue(hash, offset);
+    }
+}
+
+// The tables the saved indices and hashes refer to: the orientations, the
+// piece masks, the gravity curve and the Zobrist keys
+void HashTables(u64& hash) {
+    for (const auto& table : orientation_tables) {
+        HashValue(hash, table.cube_count);
+        HashValue(hash, table.orientation_count);
+        for (u32 orientation = 0; orientation < block_max_orientations;
+             ++orientation) {
+            for (u32 i = 0; i < block_max_cubes; ++i) {
+                const auto& cube = table.cubes[orientation][i];
+                HashValue(hash, (u64(u8(cube.x)) << 16) |
+                                    (u64(u8(cube.y)) << 8) | u8(cube.z));
+            }
+            HashBytes(hash, &table.next[orientation][0][0],
+                      sizeof(table.next[orientation]));
+            HashValue(hash, table.shape[orientation]);
+        }
+    }
+
+    const auto& masks = piece_mask_tables<Settings::map_depth + 1>.masks;
+    for (const auto& type_masks : masks) {
+        for (const auto& mask : type_masks) {
+            HashValue(hash, (u64(u8(mask.min.x)) << 16) |
+                                (u64(u8(mask.min.y)) << 8) | u8(mask.min.z));
+            HashValue(hash, mask.layer_count);
+            for (const auto& layer : mask.layers) {
+                HashValue(hash, layer.lo);
+                HashValue(hash, layer.hi);
+            }
+        }
+    }
+
+    for (auto ticks : gravity_table.fall_step_ticks) {
+        HashValue(hash, ticks);
+    }
+    for (auto key : zobrist_keys.cells) {
+        HashValue(hash, key);
+    }
+}
+
+u64 GetStateChecksum(const u8* bytes) {
+    u64 hash = 0xcbf29ce484222325;
+    HashBytes(hash, bytes, sizeof(GameState));
+    return hash;
+}
+
+u32 CountBits(u64 bits) {
+    auto count = 0U;
+    for (; bits; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+}
+
+// Whether the bookkeeping of the board agrees with its layers. The layers
+// with cells to erase and the column heights are used as indices.
+bool IsBoardConsistent(const Board3D& board) {
+    const auto height = Board3D::height;
+    if (board.dirty_layers.size() > height) {
+        return false;
+    }
+    u32 dirty_count = 0;
+    for (u32 y = 0; y < height; ++y) {
+        if (board.layer_dirty[y] > 1) {
+            return false;
+        }
+        dirty_count += board.layer_dirty[y];
+    }
+    // NOTE: the listed layers are distinct and flagged, and as many as the
+    // flags, so every flagged layer is listed
+    if (dirty_count != board.dirty_layers.size()) {
+        return false;
+    }
+    std::array<u8, height> listed = {};
+    for (auto layer : board.dirty_layers) {
+        if (layer >= height || !board.layer_dirty[layer] || listed[layer]) {
+            return false;
+        }
+        listed[layer] = 1;
+    }
+
+    for (auto column_height : board.column_heights) {
+        if (column_height > height) {
+            return false;
+        }
+    }
+
+    const auto& empty = Board3D::empty_layer;
+    for (u32 y = 0; y < height; ++y) {
+        const auto& layer = board.layers[y];
+        if ((layer & empty) != empty) {
+            return false;
+        }
+        auto cells = layer & ~empty;
+        if (board.layer_fill_counts[y] > Board3D::width * Board3D::depth ||
+            board.layer_fill_counts[y] !=
+                CountBits(cells.lo) + CountBits(cells.hi)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the enums and indices of a loaded state are in range, the rules
+// index tables with them
+bool IsStateInRange(const GameState& state) {
+    if (static_cast<u32>(state.phase) > static_cast<u32>(GamePhase::Lost) ||
+        static_cast<u32>(state.randomizer.generator) >
+            static_cast<u32>(Settings::BlockGenerator::Bag) ||
+        state.randomizer.bag_size > block_type_count ||
+        state.gravity_level >= gravity_table_size ||
+        state.palette.size > state.palette.colors.size() ||
+        !IsBoardConsistent(state.board)) {
+        return false;
+    }
+    for (u32 i = 0; i < state.randomizer.bag_size; ++i) {
+        if (static_cast<u32>(state.randomizer.bag[i]) >= block_type_count) {
+            return false;
+        }
+    }
+
+    const auto& block = state.falling_block;
+    auto type = static_cast<u32>(block.type);
+    if (type > block_type_count) {
+        return false;
+    }
+    // NOTE: the block which lost the game can be left above the board, the
+    // rules no longer move or merge it
+    const auto& position = block.position;
+    if (state.phase != GamePhase::Lost && (position.x < 0 || position.y < 0 || position.z < 0 ||
+        position.x >= static_cast<i32>(Board3D::width) ||
+        position.y >= static_cast<i32>(Board3D::height) ||
+        position.z >= static_cast<i32>(Board3D::depth))) {
+        return false;
+    }
+    const auto& table = orientation_tables[type];
+    return (block.type == BlockType::Undefined ||
+            block.orientation < table.orientation_count) &&
+           block.cube_offsets.size() == table.cube_count;
+}
+
+bool MoveOverFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to,
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+} // namespace
+
+u64 GetSaveLayout() {
+    u64 hash = 0xcbf29ce484222325;
+    HashValue(hash, save_version);
+    HashValue(hash, sizeof(GameState));
+    HashValue(hash, alignof(GameState));
+    HashValue(hash, sizeof(Board3D));
+    HashValue(hash, sizeof(Block));
+    HashValue(hash, sizeof(Palette));
+    HashValue(hash, sizeof(Rng));
+    HashValue(hash, sizeof(BlockRandomizer));
+    HashValue(hash, Settings::map_width);
+    HashValue(hash, Settings::map_depth);
+    HashValue(hash, Settings::map_height);
+    HashMemberOffsets(hash);
+    HashTables(hash);
+
+    // first byte of a known value tells the byte order
+    u32 byte_order = 0x01020304;
+    u8 first_byte = 0;
+    memcpy(&first_byte, &byte_order, 1);
+    HashValue(hash, first_byte);
+    return hash;
+}
+
+bool SaveGame(const char* path, const GameState& state) {
+    std::vector<u8> image(save_state_offset + sizeof(GameState), 0);
+    SaveHeader header;
+    memcpy(header.magic, save_magic, 4);
+    header.version = save_version;
+    header.layout = GetSaveLayout();
+    header.state_offset = save_state_offset;
+    header.state_size = sizeof(GameState);
+    memcpy(image.data() + save_state_offset, &state, sizeof(GameState));
+    header.state_checksum = GetStateChecksum(image.data() + save_state_offset);
+    memcpy(image.data(), &header, sizeof(header));
+
+    auto temporary_path = std::string(path) + ".tmp";
+    auto file = fopen(temporary_path.c_str(), "wb");
+    if (!file) {
+        printf("Failed to write save file: %s\n", temporary_path.c_str());
+        return false;
+    }
+    auto written = fwrite(image.data(), 1, image.size(), file);
+    auto flushed = fflush(file) == 0;
+#ifndef _WIN32
+    // the data has to be on disk before the rename makes it the save
+    flushed = flushed && fsync(fileno(file)) == 0;
+#endif
+    fclose(file);
+
+    if (written != image.size() || !flushed ||
+        !MoveOverFile(temporary_path.c_str(), path)) {
+        printf("Failed to write save file: %s\n", path);
+        remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadGame(const char* path, GameState& state) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    SaveHeader header;
+    if (file.size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, save_magic, 4) ||
+        header.version != save_version || header.layout != GetSaveLayout() ||
+        header.state_offset != save_state_offset ||
+        header.state_size != sizeof(GameState) ||
+        file.size < header.state_offset + header.state_size) {
+        printf("Ignoring save file of another build: %s\n", path);
+        return false;
+    }
+
+    const auto* bytes = file.data + header.state_offset;
+    GameState loaded;
+    memcpy(&loaded, bytes, sizeof(GameState));
+    if (GetStateChecksum(bytes) != header.state_checksum ||
+        !IsStateInRange(loaded)) {
+        printf("Ignoring damaged save file: %s\n", path);
+        return false;
+    }
+    state = loaded;
+    return true;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common.h"
+#include "logic.h"
+
+namespace GameLogic {
+
+// A save file is a header followed by the bytes of the GameState, which is
+// trivially copyable and holds no pointers. Loading maps the file and checks
+// the header, there is nothing to parse.
+struct SaveHeader {
+    char magic[4];
+    u32 version;
+    // identifies the memory layout of GameState in this build
+    u64 layout;
+    u64 state_offset;
+    u64 state_size;
+    // FNV-1a of the state bytes
+    u64 state_checksum;
+};
+
+// Layout of GameState in this build. It changes with the size, alignment or
+// member offsets of the parts of the state, with the tables its indices and
+// hashes refer to, with the board settings and with the byte order, so an
+// image written by another build is rejected.
+u64 GetSaveLayout();
+
+// Write the game to path. The file is written under a temporary name and
+// renamed over path, so a crash never leaves a partial save behind.
+bool SaveGame(const char* path, const GameState& state);
+
+// Resume the game saved in path, false when there is no compatible save or
+// when its checksum or its enums and indices are wrong
+bool LoadGame(const char* path, GameState& state);
+
+};
@@ -1,8 +1,7 @@
 #pragma once
- 
-#include "glad/glad.h"
-#define GLFW_INCLUDE_GLU
-#include "GLFW/glfw3.h"
+
+// NOTE: the game rules only depend on this file, keep it free of GL and GLFW.
+// Key bindings live in input.h.
 
 #include "common.h"
 #include "glm/glm.hpp"
@@ -12,6 +11,9 @@
 namespace Settings {
 
 enum class RendererType { Basic, Advanced };
+// Uniform draws every block type independently, Bag deals all the types
+// once in a shuffled order before starting over
+enum class BlockGenerator { Uniform, Bag };
 
 const RendererType graphics_renderer_type = RendererType::Advanced;
 const u32 graphics_resolution_width = 1920;
@@ -20,30 +22,36 @@ const bool graphics_fullscreen = false;
 const bool graphics_borderless = true;
 const bool graphics_multisampling = true;
 const bool graphics_multisampling_samples = 4;
+// frames drawn per second, 0 draws as fast as the buffer swaps allow
+const u32 graphics_frame_rate = 60;
+
+// the game rules advance in fixed ticks, whatever the frame rate
+const u32 logic_tick_rate_hz = 240;
+// ticks run by one frame at most; after a longer stall the game slows down
+// instead of running a burst of ticks
+const u32 logic_max_ticks_per_frame = 16;
 
 const f32 camera_zoom_min_fov = glm::pi<f32>() / 8.f;
 const f32 camera_zoom_max_fov = 4.f * glm::pi<f32>() / 5.f;
 
-const i32 key_playground_rotate_left = GLFW_KEY_LEFT;
-const i32 key_playground_rotate_right = GLFW_KEY_RIGHT;
-const i32 key_playground_rotate_up = GLFW_KEY_UP;
-const i32 key_playground_rotate_down = GLFW_KEY_DOWN;
-const i32 key_block_vert_rot_away = GLFW_KEY_W;
-const i32 key_block_vert_rot_towards = GLFW_KEY_S;
-const i32 key_block_horiz_rot_clock = GLFW_KEY_A;
-const i32 key_block_horiz_rot_counterclock = GLFW_KEY_D;
-const i32 key_block_move_away = GLFW_KEY_Q;
-const i32 key_block_move_towards = GLFW_KEY_E;
-const i32 key_block_accelerate = GLFW_KEY_SPACE;
-const i32 key_quit = GLFW_KEY_ESCAPE;
-
 const u32 map_width = 10;
 const u32 map_depth = 10;
 const u32 map_height = 22;
 
-const f32 block_init_fall_step_seconds = 1 / 2.f;
-const f32 block_max_fall_step_seconds = 1 / 25.f;
-const f32 block_speed_inc_multiplier = 0.02f;
-const f32 block_speed_inc_period_seconds = 10.f;
+// gravity in logic ticks, integers so that every machine plays the same game
+const u32 block_init_fall_step_ticks = logic_tick_rate_hz / 2;
+const u32 block_max_fall_step_ticks = logic_tick_rate_hz / 25;
+// every period the fall step changes by this percentage
+const u32 block_speed_inc_percent = 2;
+const u32 block_speed_inc_period_ticks = 10 * logic_tick_rate_hz;
+const BlockGenerator block_generator = BlockGenerator::Uniform;
+
+// the game is recorded to this replay file, nullptr to disable
+const char* const replay_path = "last_game.t3dr";
+// an unfinished game is saved here on exit and resumed on start, nullptr to
+// disable
+const char* const save_path = "savegame.t3ds";
+// playback keeps a snapshot of the game every this many blocks to seek
+const u32 replay_keyframe_blocks = 50;
 
 };
\ No newline at end of file
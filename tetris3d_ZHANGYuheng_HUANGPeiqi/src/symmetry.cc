@@ -0,0 +1,241 @@
+#include "symmetry.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace GameLogic {
+
+namespace {
+
+const u32 all_symmetries = (1u << footprint_symmetry_count) - 1;
+
+bool IsLower(const LayerMask& a, const LayerMask& b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+// splitmix64 finalizer
+u64 Mix(u64 value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Cubes of the block moved by the symmetry, as sorted keys
+struct CubeKeys {
+    u32 count = 0;
+    u32 keys[block_max_cubes] = {};
+
+    bool operator<(const CubeKeys& other) const {
+        return std::lexicographical_compare(keys, keys + count, other.keys,
+                                            other.keys + other.count);
+    }
+};
+
+CubeKeys GetCubeKeys(const Block& block, u32 symmetry) {
+    CubeKeys cubes;
+    for (auto& offset : block.cube_offsets) {
+        auto cube = TransformCell(block.position + offset, symmetry);
+        // NOTE: the cubes of a block in play stay a few cells around the
+        // board, the keys are biased to keep them positive
+        cubes.keys[cubes.count++] = static_cast<u32>(cube.y + 128) << 16 |
+                                    static_cast<u32>(cube.x + 128) << 8 |
+                                    static_cast<u32>(cube.z + 128);
+    }
+    std::sort(cubes.keys, cubes.keys + cubes.count);
+    return cubes;
+}
+
+// Keep the symmetries giving the minimal board, then the minimal block
+u32 FindCanonicalSymmetry(const Board3D& board, const Block* block) {
+    const auto column_count = Board3D::width * Board3D::depth;
+    auto candidates = all_symmetries;
+    // stops once a single candidate is left
+    for (u32 y = 0; y < Board3D::height && (candidates & (candidates - 1));
+         ++y) {
+        // NOTE: empty and full layers are the same in every variant
+        auto fill_count = board.layer_fill_counts[y];
+        if (fill_count == 0 || fill_count == column_count) {
+            continue;
+        }
+        LayerMask variants[footprint_symmetry_count];
+        LayerMask lowest = ~LayerMask{};
+        for (u32 symmetry = 0; symmetry < footprint_symmetry_count;
+             ++symmetry) {
+            if (candidates & (1u << symmetry)) {
+                variants[symmetry] =
+                    TransformLayer(board.layers[y], symmetry);
+                if (IsLower(variants[symmetry], lowest)) {
+                    lowest = variants[symmetry];
+                }
+            }
+        }
+        for (u32 symmetry = 0; symmetry < footprint_symmetry_count;
+             ++symmetry) {
+            if ((candidates & (1u << symmetry)) &&
+                variants[symmetry] != lowest) {
+                candidates &= ~(1u << symmetry);
+            }
+        }
+    }
+
+    auto best = 0U;
+    while (!(candidates & (1u << best))) {
+        ++best;
+    }
+    if (!block) {
+        return best;
+    }
+    auto best_cubes = GetCubeKeys(*block, best);
+    for (auto symmetry = best + 1; symmetry < footprint_symmetry_count;
+         ++symmetry) {
+        if (candidates & (1u << symmetry)) {
+            auto cubes = GetCubeKeys(*block, symmetry);
+            if (cubes < best_cubes) {
+                best = symmetry;
+                best_cubes = cubes;
+            }
+        }
+    }
+    return best;
+}
+
+u64 HashBoardVariant(const Board3D& board, u32 symmetry) {
+    u64 hash = 0;
+    for (u32 y = 0; y < Board3D::height; ++y) {
+        auto layer = board.layer_fill_counts[y]
+                         ? TransformLayer(board.layers[y], symmetry)
+                         : board.layers[y];
+        hash = Mix(hash ^ layer.lo);
+        hash = Mix(hash ^ layer.hi);
+    }
+    return hash;
+}
+
+} // namespace
+
+glm::ivec3 TransformCell(const glm::ivec3& cell, u32 symmetry) {
+    const auto last = static_cast<i32>(Board3D::width) - 1;
+    auto x = symmetry & 1 ? last - cell.x : cell.x;
+    auto z = symmetry & 2 ? last - cell.z : cell.z;
+    if (symmetry & 4) {
+        std::swap(x, z);
+    }
+    return glm::ivec3(x, cell.y, z);
+}
+
+LayerMask TransformLayer(const LayerMask& layer, u32 symmetry) {
+    const auto size = static_cast<i32>(Board3D::width);
+    const auto row_stride = size + 1;
+    auto cells = layer & footprint_masks.cells;
+    if (symmetry & 1) {
+        LayerMask mirrored;
+        for (i32 x = 0; x < size; ++x) {
+            mirrored = mirrored | (cells & footprint_masks.rows[x])
+                                      .Shifted(row_stride * (size - 1 - 2 * x));
+        }
+        cells = mirrored;
+    }
+    if (symmetry & 2) {
+        LayerMask mirrored;
+        for (i32 z = 0; z < size; ++z) {
+            mirrored = mirrored | (cells & footprint_masks.columns[z])
+                                      .Shifted(size - 1 - 2 * z);
+        }
+        cells = mirrored;
+    }
+    if (symmetry & 4) {
+        // (x, z) moves to (z, x), by (z - x) * (row_stride - 1) bits
+        LayerMask swapped;
+        for (i32 diagonal = 1 - size; diagonal < size; ++diagonal) {
+            swapped = swapped |
+                      (cells & footprint_masks.diagonals[diagonal + size - 1])
+                          .Shifted(diagonal * size);
+        }
+        cells = swapped;
+    }
+    return cells | Board3D::empty_layer;
+}
+
+Block TransformBlock(const Block& block, u32 symmetry) {
+    if (block.cube_offsets.empty()) {
+        return block;
+    }
+    // the symmetries are affine, the offsets move with their linear part
+    auto position = TransformCell(block.position, symmetry);
+    CubeOffset cubes[block_max_cubes];
+    auto count = static_cast<u32>(block.cube_offsets.size());
+    for (u32 i = 0; i < count; ++i) {
+        auto cube =
+            TransformCell(block.position + block.cube_offsets[i], symmetry) -
+            position;
+        cubes[i] = {static_cast<i8>(cube.x), static_cast<i8>(cube.y),
+                    static_cast<i8>(cube.z)};
+    }
+    detail::SortCubes(cubes, count);
+
+    const auto& table = GetOrientationTable(block.type);
+    for (u32 orientation = 0; orientation < table.orientation_count;
+         ++orientation) {
+        const auto* orientation_cubes = table.cubes[orientation];
+        if (detail::AreTranslatedCubes(orientation_cubes, cubes, count)) {
+            auto result = block;
+            result.SetOrientation(orientation);
+            result.position =
+                position + glm::ivec3(cubes[0].x - orientation_cubes[0].x,
+                                      cubes[0].y - orientation_cubes[0].y,
+                                      cubes[0].z - orientation_cubes[0].z);
+            return result;
+        }
+    }
+    assert(false && "a mirror image of a flat block is one of its rotations");
+    return block;
+}
+
+void TransformBoard(const Board3D& board, u32 symmetry, Board3D& result) {
+    result = Board3D();
+    for (u32 y = 0; y < Board3D::height; ++y) {
+        if (!board.layer_fill_counts[y]) {
+            continue;
+        }
+        for (u32 x = 0; x < Board3D::width; ++x) {
+            for (u32 z = 0; z < Board3D::depth; ++z) {
+                auto cell = glm::ivec3(x, y, z);
+                auto value = board.cells[board.PositionToIndex(cell)];
+                if (value) {
+                    result.Fill(TransformCell(cell, symmetry), value);
+                }
+            }
+        }
+    }
+    // the layers keep their height, and so their pending erases
+    result.ClearDirtyLayers();
+    for (auto layer : board.dirty_layers) {
+        result.MarkLayerDirty(layer);
+    }
+}
+
+u32 FindCanonicalSymmetry(const Board3D& board) {
+    return FindCanonicalSymmetry(board, nullptr);
+}
+
+u32 FindCanonicalSymmetry(const Board3D& board, const Block& block) {
+    return FindCanonicalSymmetry(board, &block);
+}
+
+u64 GetCanonicalHash(const Board3D& board) {
+    return HashBoardVariant(board, FindCanonicalSymmetry(board, nullptr));
+}
+
+u64 GetCanonicalHash(const Board3D& board, const Block& block) {
+    auto symmetry = FindCanonicalSymmetry(board, &block);
+    auto hash = HashBoardVariant(board, symmetry);
+    auto cubes = GetCubeKeys(block, symmetry);
+    hash = Mix(hash ^ static_cast<u64>(block.type));
+    for (u32 i = 0; i < cubes.count; ++i) {
+        hash = Mix(hash ^ cubes.keys[i]);
+    }
+    return hash;
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "bitboard.h"
+#include "board.h"
+#include "common.h"
+#include "glm/vec3.hpp"
+#include "logic.h"
+#include "settings.h"
+
+namespace GameLogic {
+
+// Symmetries of the square footprint of the board: the 4 rotations and 4
+// reflections of the dihedral group D4. A symmetry mirrors x when its bit 0
+// is set, then z when its bit 1 is set, then swaps x and z when its bit 2
+// is set. Symmetry 0 is the identity.
+const u32 footprint_symmetry_count = 8;
+
+static_assert(Settings::map_width == Settings::map_depth,
+              "the footprint symmetries need a square board");
+
+// Cells of a layer mask grouped by the distance a symmetry moves them
+struct FootprintMasks {
+    // every cell, without the guard bits
+    LayerMask cells;
+    // cells with the same x
+    LayerMask rows[Settings::map_width];
+    // cells with the same z
+    LayerMask columns[Settings::map_depth];
+    // cells with the same z - x, from 1 - width
+    LayerMask diagonals[2 * Settings::map_width - 1];
+};
+
+namespace detail {
+
+constexpr FootprintMasks MakeFootprintMasks() {
+    FootprintMasks masks;
+    const auto size = Settings::map_width;
+    for (u32 x = 0; x < size; ++x) {
+        for (u32 z = 0; z < size; ++z) {
+            auto bit = x * (size + 1) + z;
+            masks.cells.Set(bit);
+            masks.rows[x].Set(bit);
+            masks.columns[z].Set(bit);
+            masks.diagonals[z + size - 1 - x].Set(bit);
+        }
+    }
+    return masks;
+}
+
+} // namespace detail
+
+inline constexpr FootprintMasks footprint_masks =
+    detail::MakeFootprintMasks();
+
+// Symmetry undoing the given one
+constexpr u32 InverseSymmetry(u32 symmetry) {
+    // mirroring x then swapping is swapping then mirroring z
+    if (symmetry & 4) {
+        return 4 | (symmetry & 1) << 1 | (symmetry & 2) >> 1;
+    }
+    return symmetry;
+}
+
+glm::ivec3 TransformCell(const glm::ivec3& cell, u32 symmetry);
+
+// Layer moved by the symmetry. The cells moving the same distance are moved
+// together by one masked shift: a row or a column per shift for the
+// mirrors, a diagonal for the swap.
+LayerMask TransformLayer(const LayerMask& layer, u32 symmetry);
+
+// Block whose cubes are the ones of block moved by the symmetry, in the
+// orientation of its type with these cubes
+// NOTE: every block is flat, so its mirror images are rotations of it
+Block TransformBlock(const Block& block, u32 symmetry);
+
+// Board moved by the symmetry, cell by cell with its colors
+void TransformBoard(const Board3D& board, u32 symmetry, Board3D& result);
+
+// Symmetry mapping the board, and the block when given, to the minimal of
+// their 8 variants. The variants are ordered by their layers from the
+// bottom, each read as a 128-bit number, then by the cubes of the block.
+// Variants equal to the minimal one give the lowest symmetry.
+u32 FindCanonicalSymmetry(const Board3D& board);
+u32 FindCanonicalSymmetry(const Board3D& board, const Block& block);
+
+// Hash of the minimal variant, equal for the 8 variants of a board, or of
+// a board and a block
+u64 GetCanonicalHash(const Board3D& board);
+u64 GetCanonicalHash(const Board3D& board, const Block& block);
+
+} // namespace GameLogic
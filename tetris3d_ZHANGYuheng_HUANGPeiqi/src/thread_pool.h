@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+// Work stealing thread pool. Every worker has its own queue, runs its tasks
+// newest first and steals the oldest tasks of the other workers when its
+// queue is empty. The task counters are atomic: the pool mutex is only
+// taken to put idle workers to sleep and to wake them up, and by Wait.
+class ThreadPool {
+  public:
+    // A task gets the index of the worker running it, in [0, thread count)
+    using Task = std::function<void(u32)>;
+
+    explicit ThreadPool(u32 thread_count = DefaultThreadCount()) {
+        thread_count = std::max(thread_count, 1u);
+        for (u32 i = 0; i < thread_count; ++i) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (u32 i = 0; i < thread_count; ++i) {
+            threads.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static u32 DefaultThreadCount() {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    u32 GetThreadCount() const { return static_cast<u32>(threads.size()); }
+
+    // Queue a task. A task submitted by a worker goes to the queue of that
+    // worker, the others fill the queues round robin.
+    void Submit(Task task) {
+        size_t index = 0;
+        if (current_pool == this) {
+            index = current_worker;
+        } else {
+            index = next_queue.fetch_add(1, std::memory_order_relaxed) %
+                    queues.size();
+        }
+        // the counters are raised before a worker can pop the task and
+        // lower them
+        pending_tasks.fetch_add(1);
+        queued_tasks.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> queue_lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        // NOTE: a worker going to sleep counts itself before it checks
+        // queued_tasks, so either it sees the task or it is counted here
+        if (sleeping_workers.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            work_available.notify_one();
+        }
+    }
+
+    // Block until every submitted task has finished
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        all_done.wait(lock, [this] { return pending_tasks.load() == 0; });
+    }
+
+  private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool TryPop(u32 worker, Task& task) {
+        auto& own = *queues[worker];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto& victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerLoop(u32 worker) {
+        current_pool = this;
+        current_worker = worker;
+        Task task;
+        while (true) {
+            if (TryPop(worker, task)) {
+                queued_tasks.fetch_sub(1);
+                task(worker);
+                task = nullptr;
+
+                if (pending_tasks.fetch_sub(1) == 1) {
+                    // under the lock, so that Wait cannot miss it between
+                    // its check and its sleep
+                    std::lock_guard<std::mutex> lock(mutex);
+                    all_done.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping_workers.fetch_add(1);
+            work_available.wait(lock, [this] {
+                return stopping || queued_tasks.load() > 0;
+            });
+            sleeping_workers.fetch_sub(1);
+            if (stopping && queued_tasks.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<u32> next_queue{0};
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    // tasks in the queues, and tasks not finished yet
+    std::atomic<u64> queued_tasks{0};
+    std::atomic<u64> pending_tasks{0};
+    // workers waiting on work_available
+    std::atomic<u32> sleeping_workers{0};
+    bool stopping = false;
+
+    // pool and index of the worker running on this thread
+    static inline thread_local const ThreadPool* current_pool = nullptr;
+    static inline thread_local u32 current_worker = 0;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "common.h"
+
+// Lock free hash table from 64 bit hashes to values, shared by the threads
+// of a search. Slots are claimed with a compare and swap on their key and
+// probed linearly. The table keeps the lowest value inserted for a hash,
+// so what it holds once the inserts are done does not depend on their
+// order or on the thread timing.
+class TranspositionTable {
+  public:
+    // Empty the table and make room for at least capacity hashes. Not safe
+    // while other threads use the table.
+    void Reset(size_t capacity) {
+        // at most half full, so that the probes stay short
+        size_t size = 16;
+        while (size < 2 * capacity) {
+            size *= 2;
+        }
+        if (size > slot_count) {
+            slots.reset(new Slot[size]);
+            slot_count = size;
+        } else {
+            for (size_t i = 0; i < slot_count; ++i) {
+                slots[i].key.store(empty_key, std::memory_order_relaxed);
+                slots[i].value.store(no_value, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Keep value for the hash if it is lower than the one stored, false
+    // when the table is full
+    bool Insert(u64 hash, u64 value) {
+        auto key = ToKey(hash);
+        auto mask = slot_count - 1;
+        for (size_t probe = 0; probe < slot_count; ++probe) {
+            auto& slot = slots[(key + probe) & mask];
+            auto slot_key = slot.key.load(std::memory_order_acquire);
+            if (slot_key == empty_key &&
+                slot.key.compare_exchange_strong(slot_key, key,
+                                                 std::memory_order_acq_rel)) {
+                slot_key = key;
+            }
+            if (slot_key != key) {
+                continue;
+            }
+            auto stored = slot.value.load(std::memory_order_relaxed);
+            while (value < stored &&
+                   !slot.value.compare_exchange_weak(
+                       stored, value, std::memory_order_relaxed)) {
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool Find(u64 hash, u64& value) const {
+        auto key = ToKey(hash);
+        auto mask = slot_count - 1;
+        for (size_t probe = 0; probe < slot_count; ++probe) {
+            const auto& slot = slots[(key + probe) & mask];
+            auto slot_key = slot.key.load(std::memory_order_acquire);
+            if (slot_key == empty_key) {
+                return false;
+            }
+            if (slot_key == key) {
+                value = slot.value.load(std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    static constexpr u64 empty_key = 0;
+    static constexpr u64 no_value = ~u64(0);
+
+    struct Slot {
+        std::atomic<u64> key{empty_key};
+        std::atomic<u64> value{no_value};
+    };
+
+    // NOTE: the key 0 marks the empty slots, the hash 0 shares the key 1
+    static u64 ToKey(u64 hash) { return hash ? hash : 1; }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t slot_count = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common.h"
+#include "orientation.h"
+
+namespace GameLogic {
+
+// Random keys of the Zobrist hashes. A hash is the xor of the keys of what
+// is there, so adding or removing one thing updates it with a single xor.
+//
+// A filled cell has the key of its bit in the layer mask rotated left by
+// its layer. A layer moving down keeps its keys up to a rotation, so the
+// board hash follows an erase from the per-layer hashes without touching
+// the cells.
+struct ZobristKeys {
+    // by bit of the layer mask
+    u64 cells[128] = {};
+    u64 types[block_type_count + 1] = {};
+    u64 orientations[block_max_orientations] = {};
+    // by coordinate, from zobrist_min_coordinate
+    u64 x[64] = {};
+    u64 y[64] = {};
+    u64 z[64] = {};
+};
+
+// Lowest block coordinate with a key, the spawn and the fixes stay within
+// a few cells of the board
+const i32 zobrist_min_coordinate = -16;
+
+constexpr u64 RotateLeft(u64 value, u32 shift) {
+    shift %= 64;
+    return shift ? (value << shift) | (value >> (64 - shift)) : value;
+}
+
+namespace detail {
+
+constexpr u64 NextZobristKey(u64& seed) {
+    // splitmix64
+    seed += 0x9e3779b97f4a7c15;
+    auto z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys() {
+    ZobristKeys keys;
+    u64 seed = 0x3d3d3d3d;
+    for (auto& key : keys.cells) {
+        key = NextZobristKey(seed);
+    }
+    for (auto& key : keys.types) {
+        key = NextZobristKey(seed);
+    }
+    for (auto& key : keys.orientations) {
+        key = NextZobristKey(seed);
+    }
+    for (u32 i = 0; i < 64; ++i) {
+        keys.x[i] = NextZobristKey(seed);
+        keys.y[i] = NextZobristKey(seed);
+        keys.z[i] = NextZobristKey(seed);
+    }
+    return keys;
+}
+
+} // namespace detail
+
+inline constexpr ZobristKeys zobrist_keys = detail::MakeZobristKeys();
+
+// Key of the cell with the given bit in layer y
+constexpr u64 ZobristCellKey(u32 bit, u32 y) {
+    return RotateLeft(zobrist_keys.cells[bit], y);
+}
+
+// Key of a block coordinate, coordinates out of the key range wrap around
+constexpr u64 ZobristCoordinateKey(const u64 (&keys)[64], i32 value) {
+    return keys[static_cast<u32>(value - zobrist_min_coordinate) % 64];
+}
+
+} // namespace GameLogic